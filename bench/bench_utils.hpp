@@ -0,0 +1,76 @@
+// Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2018 - 2026 Daniil Goncharov <neargye@gmail.com>.
+//
+// Permission is hereby  granted, free of charge, to any  person obtaining a copy
+// of this software and associated  documentation files (the "Software"), to deal
+// in the Software  without restriction, including without  limitation the rights
+// to  use, copy,  modify, merge,  publish, distribute,  sublicense, and/or  sell
+// copies  of  the Software,  and  to  permit persons  to  whom  the Software  is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE  IS PROVIDED "AS  IS", WITHOUT WARRANTY  OF ANY KIND,  EXPRESS OR
+// IMPLIED,  INCLUDING BUT  NOT  LIMITED TO  THE  WARRANTIES OF  MERCHANTABILITY,
+// FITNESS FOR  A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT  SHALL THE
+// AUTHORS  OR COPYRIGHT  HOLDERS  BE  LIABLE FOR  ANY  CLAIM,  DAMAGES OR  OTHER
+// LIABILITY, WHETHER IN AN ACTION OF  CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE  OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace bench {
+
+// Number of heap allocations made by the process so far. On glibc this counts the malloc family, so
+// allocations inside the TensorFlow runtime are included; elsewhere only C++ operator new is counted.
+std::uint64_t AllocationCount();
+
+// True when AllocationCount also observes allocations made through malloc by TensorFlow itself.
+bool CountsMallocAllocations();
+
+// Resident set size of the process in bytes, or 0 where it is not available.
+std::size_t ResidentMemoryBytes();
+
+// Voluntary plus involuntary context switches of all threads in the process so far, or 0 where it is not available.
+std::uint64_t ContextSwitches();
+
+// Number of threads in the process, or 0 where it is not available.
+std::size_t ThreadCount();
+
+// Nearest-rank percentile in [0, 100]; sorts the samples in place.
+inline double Percentile(std::vector<double>& samples, double percentile) {
+  if (samples.empty()) {
+    return 0.0;
+  }
+
+  std::sort(samples.begin(), samples.end());
+  const auto rank = static_cast<std::size_t>(percentile / 100.0 * static_cast<double>(samples.size() - 1) + 0.5);
+  return samples[std::min(rank, samples.size() - 1)];
+}
+
+class Stopwatch {
+ public:
+  Stopwatch() : start_(std::chrono::steady_clock::now()) {}
+
+  double ElapsedNanoseconds() const {
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start_).count();
+  }
+
+  void Restart() {
+    start_ = std::chrono::steady_clock::now();
+  }
+
+ private:
+  std::chrono::steady_clock::time_point start_;
+};
+
+} // namespace bench
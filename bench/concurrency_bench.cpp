@@ -0,0 +1,254 @@
+// Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2018 - 2026 Daniil Goncharov <neargye@gmail.com>.
+//
+// Permission is hereby  granted, free of charge, to any  person obtaining a copy
+// of this software and associated  documentation files (the "Software"), to deal
+// in the Software  without restriction, including without  limitation the rights
+// to  use, copy,  modify, merge,  publish, distribute,  sublicense, and/or  sell
+// copies  of  the Software,  and  to  permit persons  to  whom  the Software  is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE  IS PROVIDED "AS  IS", WITHOUT WARRANTY  OF ANY KIND,  EXPRESS OR
+// IMPLIED,  INCLUDING BUT  NOT  LIMITED TO  THE  WARRANTIES OF  MERCHANTABILITY,
+// FITNESS FOR  A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT  SHALL THE
+// AUTHORS  OR COPYRIGHT  HOLDERS  BE  LIABLE FOR  ANY  CLAIM,  DAMAGES OR  OTHER
+// LIABILITY, WHETHER IN AN ACTION OF  CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE  OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "bench_utils.hpp"
+#include "tf_utils.hpp"
+#include <scope_guard.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+namespace {
+
+enum class Strategy {
+  SharedSession, // One session, SharedSessionRunner from every thread.
+  SessionPool,   // One session per thread, checked out from a SessionPool for every run.
+};
+
+const char* ToString(Strategy strategy) {
+  switch (strategy) {
+    case Strategy::SharedSession:
+      return "shared";
+    case Strategy::SessionPool:
+      return "pool";
+  }
+  return "unknown";
+}
+
+struct Model {
+  TF_Graph* graph = nullptr;
+  TF_Output input{nullptr, 0};
+  TF_Output output{nullptr, 0};
+};
+
+struct BenchResult {
+  std::size_t runs = 0;
+  double seconds = 0.0;
+  double p50_us = 0.0;
+  double p99_us = 0.0;
+  std::size_t memory_bytes = 0;
+};
+
+// Starts every worker at once so thread start-up does not skew the measured interval.
+template <typename RunOnce>
+bool RunWorkers(std::size_t thread_count, std::size_t iterations, RunOnce run_once, BenchResult& result) {
+  std::atomic<std::size_t> ready{0};
+  std::atomic<bool> start{false};
+  std::atomic<bool> failed{false};
+  std::vector<std::vector<double>> latencies(thread_count);
+  std::vector<std::thread> threads;
+  threads.reserve(thread_count);
+
+  for (std::size_t t = 0; t < thread_count; ++t) {
+    threads.emplace_back([&, t] {
+      const std::vector<std::int64_t> dims = {1, 5, 12};
+      const std::vector<float> values(60, static_cast<float>(t));
+      std::vector<TF_Tensor*> input_tensors = {tf_utils::CreateTensor(TF_FLOAT, dims, values)};
+      SCOPE_EXIT{ tf_utils::DeleteTensors(input_tensors); };
+      std::vector<TF_Tensor*> output_tensors;
+      latencies[t].reserve(iterations);
+
+      ready.fetch_add(1);
+      while (!start.load()) {
+        std::this_thread::yield();
+      }
+
+      for (std::size_t i = 0; i < iterations && !failed.load(std::memory_order_relaxed); ++i) {
+        bench::Stopwatch stopwatch;
+        const auto code = run_once(input_tensors, output_tensors);
+        latencies[t].push_back(stopwatch.ElapsedNanoseconds() / 1000.0);
+        tf_utils::DeleteTensors(output_tensors);
+        output_tensors.clear();
+        if (code != TF_OK) {
+          failed = true;
+        }
+      }
+    });
+  }
+
+  while (ready.load() != thread_count) {
+    std::this_thread::yield();
+  }
+  bench::Stopwatch stopwatch;
+  start = true;
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  result.seconds = stopwatch.ElapsedNanoseconds() / 1.0e9;
+
+  std::vector<double> all_latencies;
+  for (const auto& thread_latencies : latencies) {
+    all_latencies.insert(all_latencies.end(), thread_latencies.begin(), thread_latencies.end());
+  }
+  result.runs = all_latencies.size();
+  result.p50_us = bench::Percentile(all_latencies, 50.0);
+  result.p99_us = bench::Percentile(all_latencies, 99.0);
+
+  return !failed.load();
+}
+
+bool RunShared(const Model& model, std::size_t thread_count, std::size_t iterations, BenchResult& result) {
+  const auto memory_before = bench::ResidentMemoryBytes();
+  auto session = tf_utils::CreateSession(model.graph);
+  SCOPE_EXIT{ tf_utils::DeleteSession(session); };
+  if (session == nullptr) {
+    return false;
+  }
+
+  const tf_utils::SharedSessionRunner runner(session, {model.input}, {model.output});
+  // Outputs stay in the per-thread scratch array and are deleted by the thread's next run.
+  const auto run_once = [&runner](const std::vector<TF_Tensor*>& inputs, std::vector<TF_Tensor*>&) {
+    return runner.Run(inputs);
+  };
+
+  BenchResult warmup;
+  if (!RunWorkers(1, 1, run_once, warmup)) {
+    return false;
+  }
+  const auto memory_after = bench::ResidentMemoryBytes();
+  result.memory_bytes = memory_after > memory_before ? memory_after - memory_before : 0;
+
+  return RunWorkers(thread_count, iterations, run_once, result);
+}
+
+bool RunPool(const Model& model, std::size_t thread_count, std::size_t iterations, BenchResult& result) {
+  const auto memory_before = bench::ResidentMemoryBytes();
+  auto pool = tf_utils::CreateSessionPool(model.graph, thread_count);
+  SCOPE_EXIT{ tf_utils::DeleteSessionPool(pool); };
+  if (pool == nullptr) {
+    return false;
+  }
+
+  const auto run_once = [pool, &model](const std::vector<TF_Tensor*>& inputs, std::vector<TF_Tensor*>& outputs) {
+    auto lease = pool->Acquire();
+    outputs.assign(1, nullptr);
+    return tf_utils::RunSession(lease.session(), &model.input, inputs.data(), 1, &model.output, outputs.data(), 1);
+  };
+
+  // Warm every session up so its memory is counted and first-run costs stay out of the measurement.
+  BenchResult warmup;
+  if (!RunWorkers(thread_count, 1, run_once, warmup)) {
+    return false;
+  }
+  const auto memory_after = bench::ResidentMemoryBytes();
+  result.memory_bytes = memory_after > memory_before ? memory_after - memory_before : 0;
+
+  return RunWorkers(thread_count, iterations, run_once, result);
+}
+
+void PrintHeader() {
+  std::cout << std::left
+            << std::setw(8) << "mode"
+            << std::right
+            << std::setw(8) << "threads"
+            << std::setw(10) << "sessions"
+            << std::setw(10) << "runs"
+            << std::setw(12) << "runs/s"
+            << std::setw(10) << "p50 us"
+            << std::setw(10) << "p99 us"
+            << std::setw(12) << "memory MB"
+            << std::setw(14) << "runs/s per GB"
+            << std::endl;
+}
+
+void PrintRow(Strategy strategy, std::size_t thread_count, const BenchResult& result) {
+  const auto throughput = result.seconds > 0.0 ? static_cast<double>(result.runs) / result.seconds : 0.0;
+  const auto memory_gb = static_cast<double>(result.memory_bytes) / (1024.0 * 1024.0 * 1024.0);
+  std::cout << std::left
+            << std::setw(8) << ToString(strategy)
+            << std::right << std::fixed
+            << std::setw(8) << thread_count
+            << std::setw(10) << (strategy == Strategy::SharedSession ? 1 : thread_count)
+            << std::setw(10) << result.runs
+            << std::setprecision(0)
+            << std::setw(12) << throughput
+            << std::setprecision(1)
+            << std::setw(10) << result.p50_us
+            << std::setw(10) << result.p99_us
+            << std::setw(12) << static_cast<double>(result.memory_bytes) / (1024.0 * 1024.0);
+  if (memory_gb > 0.0) {
+    std::cout << std::setprecision(0) << std::setw(14) << throughput / memory_gb;
+  } else {
+    std::cout << std::setw(14) << "n/a";
+  }
+  std::cout << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  const bool quick = argc > 1 && std::strcmp(argv[1], "--quick") == 0;
+
+  Model model;
+  model.graph = tf_utils::LoadGraph("graph.pb");
+  SCOPE_EXIT{ tf_utils::DeleteGraph(model.graph); };
+  if (model.graph == nullptr) {
+    std::cout << "Failed to load graph" << std::endl;
+    return 1;
+  }
+
+  model.input = TF_Output{TF_GraphOperationByName(model.graph, "input_4"), 0};
+  model.output = TF_Output{TF_GraphOperationByName(model.graph, "output_node0"), 0};
+  if (model.input.oper == nullptr || model.output.oper == nullptr) {
+    std::cout << "Failed to find input or output operation" << std::endl;
+    return 2;
+  }
+
+  const std::vector<std::size_t> thread_counts = quick ? std::vector<std::size_t>{1, 2} : std::vector<std::size_t>{1, 2, 4, 8, 16, 32, 64};
+  const std::size_t runs_per_config = quick ? 20 : 20000;
+
+  std::cout << "TensorFlow " << TF_Version() << ", models/graph.pb, hardware threads: " << std::thread::hardware_concurrency() << std::endl;
+  PrintHeader();
+
+  for (const auto thread_count : thread_counts) {
+    const auto iterations = std::max<std::size_t>(10, runs_per_config / thread_count);
+    for (const auto strategy : {Strategy::SharedSession, Strategy::SessionPool}) {
+      BenchResult result;
+      const auto ok = strategy == Strategy::SharedSession
+                          ? RunShared(model, thread_count, iterations, result)
+                          : RunPool(model, thread_count, iterations, result);
+      if (!ok) {
+        std::cout << "Failed to run " << ToString(strategy) << " benchmark with " << thread_count << " threads" << std::endl;
+        return 3;
+      }
+
+      PrintRow(strategy, thread_count, result);
+    }
+  }
+
+  return 0;
+}
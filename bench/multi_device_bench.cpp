@@ -0,0 +1,279 @@
+// Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2018 - 2026 Daniil Goncharov <neargye@gmail.com>.
+//
+// Permission is hereby  granted, free of charge, to any  person obtaining a copy
+// of this software and associated  documentation files (the "Software"), to deal
+// in the Software  without restriction, including without  limitation the rights
+// to  use, copy,  modify, merge,  publish, distribute,  sublicense, and/or  sell
+// copies  of  the Software,  and  to  permit persons  to  whom  the Software  is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE  IS PROVIDED "AS  IS", WITHOUT WARRANTY  OF ANY KIND,  EXPRESS OR
+// IMPLIED,  INCLUDING BUT  NOT  LIMITED TO  THE  WARRANTIES OF  MERCHANTABILITY,
+// FITNESS FOR  A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT  SHALL THE
+// AUTHORS  OR COPYRIGHT  HOLDERS  BE  LIABLE FOR  ANY  CLAIM,  DAMAGES OR  OTHER
+// LIABILITY, WHETHER IN AN ACTION OF  CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE  OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "bench_utils.hpp"
+#include "tf_utils.hpp"
+#include <scope_guard.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+enum class PlacementMode {
+  SingleDevice, // One CPU device and an intra-op pool as wide as the machine.
+  MultiDevice,  // device_count{"CPU": branches}, with every branch pinned to its own device.
+};
+
+const char* ToString(PlacementMode mode) {
+  switch (mode) {
+    case PlacementMode::SingleDevice:
+      return "single";
+    case PlacementMode::MultiDevice:
+      return "multi";
+  }
+  return "unknown";
+}
+
+struct WideGraph {
+  TF_Graph* graph = nullptr;
+  TF_Output input{nullptr, 0};
+  std::vector<TF_Output> outputs;
+};
+
+struct BenchResult {
+  std::size_t runs = 0;
+  double seconds = 0.0;
+  double p50_us = 0.0;
+  double p99_us = 0.0;
+};
+
+TF_Operation* AddMatrixConst(const tf_utils::GraphDeviceScope& scope, const std::string& name, std::int64_t width, TF_Status* status) {
+  const std::vector<std::int64_t> dims = {width, width};
+  std::vector<float> values(static_cast<std::size_t>(width * width));
+  for (std::size_t i = 0; i < values.size(); ++i) {
+    values[i] = static_cast<float>(i % 7) / (7.0f * static_cast<float>(width));
+  }
+  auto tensor = tf_utils::CreateTensor(TF_FLOAT, dims, values);
+  SCOPE_EXIT{ tf_utils::DeleteTensor(tensor); };
+  if (tensor == nullptr) {
+    return nullptr;
+  }
+
+  auto desc = scope.NewOperation("Const", name.c_str());
+  TF_SetAttrType(desc, "dtype", TF_FLOAT);
+  TF_SetAttrTensor(desc, "value", tensor, status);
+  if (TF_GetCode(status) != TF_OK) {
+    return nullptr;
+  }
+
+  return TF_FinishOperation(desc, status);
+}
+
+TF_Operation* AddMatMul(const tf_utils::GraphDeviceScope& scope, const std::string& name, TF_Output a, TF_Output b, TF_Status* status) {
+  auto desc = scope.NewOperation("MatMul", name.c_str());
+  TF_SetAttrType(desc, "T", TF_FLOAT);
+  TF_AddInput(desc, a);
+  TF_AddInput(desc, b);
+
+  return TF_FinishOperation(desc, status);
+}
+
+TF_Operation* AddTanh(const tf_utils::GraphDeviceScope& scope, const std::string& name, TF_Output x, TF_Status* status) {
+  auto desc = scope.NewOperation("Tanh", name.c_str());
+  TF_SetAttrType(desc, "T", TF_FLOAT);
+  TF_AddInput(desc, x);
+
+  return TF_FinishOperation(desc, status);
+}
+
+// branches independent towers of depth tanh(x * W) layers over one [batch, width] input. With pin set, tower i is
+// built under a GraphDeviceScope for /device:CPU:i.
+bool CreateWideGraph(std::size_t branches, std::size_t depth, std::int64_t batch, std::int64_t width, bool pin, WideGraph& wide) {
+  auto status = TF_NewStatus();
+  SCOPE_EXIT{ TF_DeleteStatus(status); };
+
+  wide.graph = TF_NewGraph();
+  const std::vector<std::int64_t> input_dims = {batch, width};
+  auto desc = TF_NewOperation(wide.graph, "Placeholder", "input");
+  TF_SetAttrType(desc, "dtype", TF_FLOAT);
+  TF_SetAttrShape(desc, "shape", input_dims.data(), static_cast<int>(input_dims.size()));
+  auto input = TF_FinishOperation(desc, status);
+  if (TF_GetCode(status) != TF_OK) {
+    return false;
+  }
+  wide.input = TF_Output{input, 0};
+
+  for (std::size_t branch = 0; branch < branches; ++branch) {
+    const tf_utils::GraphDeviceScope scope(wide.graph, pin ? tf_utils::CpuDeviceName(static_cast<std::int32_t>(branch)) : std::string());
+    const auto prefix = "branch_" + std::to_string(branch) + "/";
+    auto weights = AddMatrixConst(scope, prefix + "weights", width, status);
+    if (TF_GetCode(status) != TF_OK) {
+      return false;
+    }
+
+    TF_Output x = wide.input;
+    for (std::size_t layer = 0; layer < depth; ++layer) {
+      const auto suffix = std::to_string(layer);
+      auto matmul = AddMatMul(scope, prefix + "matmul_" + suffix, x, TF_Output{weights, 0}, status);
+      if (TF_GetCode(status) != TF_OK) {
+        return false;
+      }
+      auto tanh = AddTanh(scope, prefix + "tanh_" + suffix, TF_Output{matmul, 0}, status);
+      if (TF_GetCode(status) != TF_OK) {
+        return false;
+      }
+      x = TF_Output{tanh, 0};
+    }
+    wide.outputs.push_back(x);
+  }
+
+  return true;
+}
+
+TF_SessionOptions* CreateSessionOptions(PlacementMode mode, std::size_t branches, std::int32_t hardware_threads) {
+  tf_utils::SessionConfigBuilder builder;
+  if (mode == PlacementMode::SingleDevice) {
+    builder.SetIntraOpParallelismThreads(hardware_threads);
+  } else {
+    builder.SetDeviceCount("CPU", static_cast<std::int32_t>(branches))
+        .SetInterOpParallelismThreads(static_cast<std::int32_t>(branches));
+  }
+
+  return builder.CreateSessionOptions();
+}
+
+bool RunGraph(const WideGraph& wide, PlacementMode mode, std::int64_t batch, std::int64_t width, std::int32_t hardware_threads,
+              std::size_t iterations, BenchResult& result) {
+  auto options = CreateSessionOptions(mode, wide.outputs.size(), hardware_threads);
+  SCOPE_EXIT{ tf_utils::DeleteSessionOptions(options); };
+  if (options == nullptr) {
+    return false;
+  }
+
+  auto session = tf_utils::CreateSession(wide.graph, options);
+  SCOPE_EXIT{ tf_utils::DeleteSession(session); };
+  if (session == nullptr) {
+    return false;
+  }
+
+  const std::vector<std::int64_t> dims = {batch, width};
+  const std::vector<TF_Tensor*> input_tensors = {tf_utils::CreateTensor(TF_FLOAT, dims, std::vector<float>(static_cast<std::size_t>(batch * width), 1.0f))};
+  SCOPE_EXIT{ tf_utils::DeleteTensors(input_tensors); };
+  if (input_tensors[0] == nullptr) {
+    return false;
+  }
+
+  std::vector<TF_Tensor*> output_tensors(wide.outputs.size(), nullptr);
+  const auto run_once = [&] {
+    const auto code = tf_utils::RunSession(session, {wide.input}, input_tensors, wide.outputs, output_tensors);
+    tf_utils::DeleteTensors(output_tensors);
+    output_tensors.assign(wide.outputs.size(), nullptr);
+    return code == TF_OK;
+  };
+
+  // First runs pay placement and graph optimization.
+  for (std::size_t i = 0; i < 3; ++i) {
+    if (!run_once()) {
+      return false;
+    }
+  }
+
+  std::vector<double> latencies;
+  latencies.reserve(iterations);
+  bench::Stopwatch stopwatch;
+  for (std::size_t i = 0; i < iterations; ++i) {
+    bench::Stopwatch run_stopwatch;
+    if (!run_once()) {
+      return false;
+    }
+    latencies.push_back(run_stopwatch.ElapsedNanoseconds() / 1000.0);
+  }
+  result.seconds = stopwatch.ElapsedNanoseconds() / 1.0e9;
+  result.runs = latencies.size();
+  result.p50_us = bench::Percentile(latencies, 50.0);
+  result.p99_us = bench::Percentile(latencies, 99.0);
+
+  return true;
+}
+
+void PrintHeader() {
+  std::cout << std::left
+            << std::setw(8) << "mode"
+            << std::right
+            << std::setw(10) << "branches"
+            << std::setw(10) << "devices"
+            << std::setw(10) << "runs"
+            << std::setw(12) << "runs/s"
+            << std::setw(12) << "p50 us"
+            << std::setw(12) << "p99 us"
+            << std::endl;
+}
+
+void PrintRow(PlacementMode mode, std::size_t branches, const BenchResult& result) {
+  const auto throughput = result.seconds > 0.0 ? static_cast<double>(result.runs) / result.seconds : 0.0;
+  std::cout << std::left
+            << std::setw(8) << ToString(mode)
+            << std::right << std::fixed
+            << std::setw(10) << branches
+            << std::setw(10) << (mode == PlacementMode::MultiDevice ? branches : 1)
+            << std::setw(10) << result.runs
+            << std::setprecision(0)
+            << std::setw(12) << throughput
+            << std::setprecision(1)
+            << std::setw(12) << result.p50_us
+            << std::setw(12) << result.p99_us
+            << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  const bool quick = argc > 1 && std::strcmp(argv[1], "--quick") == 0;
+
+  const std::vector<std::size_t> branch_counts = quick ? std::vector<std::size_t>{2} : std::vector<std::size_t>{2, 4, 8};
+  const std::size_t depth = quick ? 2 : 8;
+  const std::int64_t batch = quick ? 2 : 64;
+  const std::int64_t width = quick ? 8 : 512;
+  const std::size_t iterations = quick ? 10 : 200;
+  const auto hardware_threads = static_cast<std::int32_t>(std::max(1u, std::thread::hardware_concurrency()));
+
+  std::cout << "TensorFlow " << TF_Version() << ", " << depth << " x MatMul[" << batch << ", " << width << "] x " << width
+            << " per branch, hardware threads: " << hardware_threads << std::endl;
+  PrintHeader();
+
+  for (const auto branches : branch_counts) {
+    for (const auto mode : {PlacementMode::SingleDevice, PlacementMode::MultiDevice}) {
+      WideGraph wide;
+      SCOPE_EXIT{ tf_utils::DeleteGraph(wide.graph); };
+      if (!CreateWideGraph(branches, depth, batch, width, mode == PlacementMode::MultiDevice, wide)) {
+        std::cout << "Failed to build graph with " << branches << " branches" << std::endl;
+        return 1;
+      }
+
+      BenchResult result;
+      if (!RunGraph(wide, mode, batch, width, hardware_threads, iterations, result)) {
+        std::cout << "Failed to run " << ToString(mode) << " benchmark with " << branches << " branches" << std::endl;
+        return 2;
+      }
+
+      PrintRow(mode, branches, result);
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,234 @@
+// Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2018 - 2026 Daniil Goncharov <neargye@gmail.com>.
+//
+// Permission is hereby  granted, free of charge, to any  person obtaining a copy
+// of this software and associated  documentation files (the "Software"), to deal
+// in the Software  without restriction, including without  limitation the rights
+// to  use, copy,  modify, merge,  publish, distribute,  sublicense, and/or  sell
+// copies  of  the Software,  and  to  permit persons  to  whom  the Software  is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE  IS PROVIDED "AS  IS", WITHOUT WARRANTY  OF ANY KIND,  EXPRESS OR
+// IMPLIED,  INCLUDING BUT  NOT  LIMITED TO  THE  WARRANTIES OF  MERCHANTABILITY,
+// FITNESS FOR  A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT  SHALL THE
+// AUTHORS  OR COPYRIGHT  HOLDERS  BE  LIABLE FOR  ANY  CLAIM,  DAMAGES OR  OTHER
+// LIABILITY, WHETHER IN AN ACTION OF  CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE  OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "bench_utils.hpp"
+#include "tf_utils.hpp"
+#include <scope_guard.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+namespace {
+
+enum class PoolMode {
+  PerSession, // use_per_session_threads: every session owns its intra-op and inter-op pools.
+  Shared,     // One process-wide pool named by every session.
+};
+
+const char* ToString(PoolMode mode) {
+  switch (mode) {
+    case PoolMode::PerSession:
+      return "per-session";
+    case PoolMode::Shared:
+      return "shared";
+  }
+  return "unknown";
+}
+
+struct Model {
+  TF_Graph* graph = nullptr;
+  TF_Output input{nullptr, 0};
+  TF_Output output{nullptr, 0};
+};
+
+struct BenchResult {
+  std::size_t runs = 0;
+  double seconds = 0.0;
+  double p99_us = 0.0;
+  std::size_t threads = 0;
+  std::uint64_t context_switches = 0;
+};
+
+TF_SessionOptions* CreateSessionOptions(PoolMode mode, std::int32_t shared_threads) {
+  tf_utils::SessionConfigBuilder builder;
+  if (mode == PoolMode::PerSession) {
+    builder.SetUsePerSessionThreads(true);
+  } else {
+    builder.UseSharedInterOpThreadPool("shared_pool_bench", shared_threads);
+  }
+
+  return builder.CreateSessionOptions();
+}
+
+// One client thread per model, as a multi-model server sees when every model gets traffic at once.
+bool RunModels(const Model& model, PoolMode mode, std::size_t model_count, std::int32_t shared_threads,
+               std::size_t iterations, BenchResult& result) {
+  auto options = CreateSessionOptions(mode, shared_threads);
+  SCOPE_EXIT{ tf_utils::DeleteSessionOptions(options); };
+  if (options == nullptr) {
+    return false;
+  }
+
+  std::vector<TF_Session*> sessions;
+  SCOPE_EXIT{
+    for (auto session : sessions) {
+      tf_utils::DeleteSession(session);
+    }
+  };
+  for (std::size_t i = 0; i < model_count; ++i) {
+    sessions.push_back(tf_utils::CreateSession(model.graph, options));
+    if (sessions.back() == nullptr) {
+      return false;
+    }
+  }
+
+  std::atomic<std::size_t> ready{0};
+  std::atomic<bool> start{false};
+  std::atomic<bool> failed{false};
+  std::vector<std::vector<double>> latencies(model_count);
+  std::vector<std::thread> threads;
+  threads.reserve(model_count);
+
+  for (std::size_t m = 0; m < model_count; ++m) {
+    threads.emplace_back([&, m] {
+      const std::vector<std::int64_t> dims = {1, 5, 12};
+      const std::vector<TF_Tensor*> input_tensors = {tf_utils::CreateTensor(TF_FLOAT, dims, std::vector<float>(60, 1.0f))};
+      SCOPE_EXIT{ tf_utils::DeleteTensors(input_tensors); };
+      std::vector<TF_Tensor*> output_tensors = {nullptr};
+      const auto run_once = [&] {
+        const auto code = tf_utils::RunSession(sessions[m], &model.input, input_tensors.data(), 1, &model.output, output_tensors.data(), 1);
+        tf_utils::DeleteTensors(output_tensors);
+        output_tensors.assign(1, nullptr);
+        if (code != TF_OK) {
+          failed = true;
+        }
+      };
+
+      // Warm up before the start line so pool creation and first-run costs stay out of the measurement.
+      run_once();
+      latencies[m].reserve(iterations);
+      ready.fetch_add(1);
+      while (!start.load()) {
+        std::this_thread::yield();
+      }
+
+      for (std::size_t i = 0; i < iterations && !failed.load(std::memory_order_relaxed); ++i) {
+        bench::Stopwatch stopwatch;
+        run_once();
+        latencies[m].push_back(stopwatch.ElapsedNanoseconds() / 1000.0);
+      }
+    });
+  }
+
+  while (ready.load() != model_count) {
+    std::this_thread::yield();
+  }
+  result.threads = bench::ThreadCount();
+  const auto context_switches_before = bench::ContextSwitches();
+  bench::Stopwatch stopwatch;
+  start = true;
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  result.seconds = stopwatch.ElapsedNanoseconds() / 1.0e9;
+  result.context_switches = bench::ContextSwitches() - context_switches_before;
+
+  std::vector<double> all_latencies;
+  for (const auto& model_latencies : latencies) {
+    all_latencies.insert(all_latencies.end(), model_latencies.begin(), model_latencies.end());
+  }
+  result.runs = all_latencies.size();
+  result.p99_us = bench::Percentile(all_latencies, 99.0);
+
+  return !failed.load();
+}
+
+void PrintHeader() {
+  std::cout << std::left
+            << std::setw(13) << "mode"
+            << std::right
+            << std::setw(8) << "models"
+            << std::setw(10) << "threads"
+            << std::setw(10) << "runs"
+            << std::setw(12) << "runs/s"
+            << std::setw(10) << "p99 us"
+            << std::setw(14) << "ctx switches"
+            << std::setw(14) << "ctx per run"
+            << std::endl;
+}
+
+void PrintRow(PoolMode mode, std::size_t model_count, const BenchResult& result) {
+  const auto throughput = result.seconds > 0.0 ? static_cast<double>(result.runs) / result.seconds : 0.0;
+  const auto switches_per_run = result.runs > 0 ? static_cast<double>(result.context_switches) / static_cast<double>(result.runs) : 0.0;
+  std::cout << std::left
+            << std::setw(13) << ToString(mode)
+            << std::right << std::fixed
+            << std::setw(8) << model_count
+            << std::setw(10) << result.threads
+            << std::setw(10) << result.runs
+            << std::setprecision(0)
+            << std::setw(12) << throughput
+            << std::setprecision(1)
+            << std::setw(10) << result.p99_us
+            << std::setw(14) << result.context_switches
+            << std::setprecision(2)
+            << std::setw(14) << switches_per_run
+            << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  const bool quick = argc > 1 && std::strcmp(argv[1], "--quick") == 0;
+
+  Model model;
+  model.graph = tf_utils::LoadGraph("graph.pb");
+  SCOPE_EXIT{ tf_utils::DeleteGraph(model.graph); };
+  if (model.graph == nullptr) {
+    std::cout << "Failed to load graph" << std::endl;
+    return 1;
+  }
+
+  model.input = TF_Output{TF_GraphOperationByName(model.graph, "input_4"), 0};
+  model.output = TF_Output{TF_GraphOperationByName(model.graph, "output_node0"), 0};
+  if (model.input.oper == nullptr || model.output.oper == nullptr) {
+    std::cout << "Failed to find input or output operation" << std::endl;
+    return 2;
+  }
+
+  const std::vector<std::size_t> model_counts = quick ? std::vector<std::size_t>{1, 2} : std::vector<std::size_t>{1, 4, 10, 20, 40};
+  const std::size_t iterations = quick ? 20 : 2000;
+  const auto shared_threads = static_cast<std::int32_t>(std::max(1u, std::thread::hardware_concurrency()));
+
+  std::cout << "TensorFlow " << TF_Version() << ", models/graph.pb, shared pool threads: " << shared_threads << std::endl;
+  PrintHeader();
+
+  // Shared pools live until the process exits, so every per-session row runs before the first shared one.
+  for (const auto mode : {PoolMode::PerSession, PoolMode::Shared}) {
+    for (const auto model_count : model_counts) {
+      BenchResult result;
+      if (!RunModels(model, mode, model_count, shared_threads, iterations, result)) {
+        std::cout << "Failed to run " << ToString(mode) << " benchmark with " << model_count << " models" << std::endl;
+        return 3;
+      }
+
+      PrintRow(mode, model_count, result);
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,367 @@
+// Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2018 - 2026 Daniil Goncharov <neargye@gmail.com>.
+//
+// Permission is hereby  granted, free of charge, to any  person obtaining a copy
+// of this software and associated  documentation files (the "Software"), to deal
+// in the Software  without restriction, including without  limitation the rights
+// to  use, copy,  modify, merge,  publish, distribute,  sublicense, and/or  sell
+// copies  of  the Software,  and  to  permit persons  to  whom  the Software  is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE  IS PROVIDED "AS  IS", WITHOUT WARRANTY  OF ANY KIND,  EXPRESS OR
+// IMPLIED,  INCLUDING BUT  NOT  LIMITED TO  THE  WARRANTIES OF  MERCHANTABILITY,
+// FITNESS FOR  A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT  SHALL THE
+// AUTHORS  OR COPYRIGHT  HOLDERS  BE  LIABLE FOR  ANY  CLAIM,  DAMAGES OR  OTHER
+// LIABILITY, WHETHER IN AN ACTION OF  CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE  OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "bench_utils.hpp"
+#include "tf_utils.hpp"
+#include <scope_guard.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+enum class LengthDistribution {
+  Sso,    // Fits the inline TF_TString buffer, no heap allocation per element.
+  Medium,
+  Large,
+};
+
+enum class ConstructionMode {
+  OwnedStrings, // CreateStringTensor(dims, std::vector<std::string>).
+  StringViews,  // CreateStringTensor(dims, std::vector<std::string_view>).
+  Files,        // CreateStringTensorFromFiles(paths).
+};
+
+const char* ToString(LengthDistribution distribution) {
+  switch (distribution) {
+    case LengthDistribution::Sso:
+      return "sso";
+    case LengthDistribution::Medium:
+      return "medium";
+    case LengthDistribution::Large:
+      return "large";
+  }
+  return "unknown";
+}
+
+const char* ToString(ConstructionMode mode) {
+  switch (mode) {
+    case ConstructionMode::OwnedStrings:
+      return "string";
+    case ConstructionMode::StringViews:
+      return "string_view";
+    case ConstructionMode::Files:
+      return "files";
+  }
+  return "unknown";
+}
+
+std::vector<std::string> MakeStrings(LengthDistribution distribution, std::size_t count) {
+  std::mt19937 rng(42);
+  std::size_t min_length = 0;
+  std::size_t max_length = 0;
+  switch (distribution) {
+    case LengthDistribution::Sso:
+      min_length = 1;
+      max_length = 22;
+      break;
+    case LengthDistribution::Medium:
+      min_length = 64;
+      max_length = 512;
+      break;
+    case LengthDistribution::Large:
+      min_length = 64 * 1024;
+      max_length = 256 * 1024;
+      break;
+  }
+
+  std::uniform_int_distribution<std::size_t> length(min_length, max_length);
+  std::uniform_int_distribution<int> byte(0, 255);
+  std::vector<std::string> strings(count);
+  for (auto& str : strings) {
+    str.resize(length(rng));
+    for (auto& c : str) {
+      c = static_cast<char>(byte(rng));
+    }
+  }
+
+  return strings;
+}
+
+struct PhaseResult {
+  double nanoseconds = 0.0;
+  std::uint64_t allocations = 0;
+};
+
+struct BenchResult {
+  PhaseResult create;
+  PhaseResult run;
+  PhaseResult read;
+  std::size_t repetitions = 0;
+};
+
+class StringGraph {
+ public:
+  StringGraph() {
+    status_ = TF_NewStatus();
+    graph_ = TF_NewGraph();
+
+    auto placeholder = TF_NewOperation(graph_, "Placeholder", "input");
+    TF_SetAttrType(placeholder, "dtype", TF_STRING);
+    input_ = TF_FinishOperation(placeholder, status_);
+    if (TF_GetCode(status_) != TF_OK) {
+      return;
+    }
+
+    auto identity = TF_NewOperation(graph_, "Identity", "output");
+    TF_SetAttrType(identity, "T", TF_STRING);
+    TF_AddInput(identity, TF_Output{input_, 0});
+    output_ = TF_FinishOperation(identity, status_);
+    if (TF_GetCode(status_) != TF_OK) {
+      return;
+    }
+
+    session_ = tf_utils::CreateSession(graph_, status_);
+  }
+
+  StringGraph(const StringGraph&) = delete;
+
+  StringGraph& operator=(const StringGraph&) = delete;
+
+  ~StringGraph() {
+    tf_utils::DeleteSession(session_);
+    tf_utils::DeleteGraph(graph_);
+    TF_DeleteStatus(status_);
+  }
+
+  bool ok() const {
+    return session_ != nullptr;
+  }
+
+  const char* message() const {
+    return TF_Message(status_);
+  }
+
+  TF_Code Run(TF_Tensor* input, TF_Tensor** output) {
+    const auto input_op = TF_Output{input_, 0};
+    const auto output_op = TF_Output{output_, 0};
+    return tf_utils::RunSession(session_, &input_op, &input, 1, &output_op, output, 1, status_);
+  }
+
+ private:
+  TF_Status* status_ = nullptr;
+  TF_Graph* graph_ = nullptr;
+  TF_Operation* input_ = nullptr;
+  TF_Operation* output_ = nullptr;
+  TF_Session* session_ = nullptr;
+};
+
+class TempFiles {
+ public:
+  explicit TempFiles(const std::vector<std::string>& contents) {
+    const auto directory = std::filesystem::temp_directory_path();
+    paths_.reserve(contents.size());
+    for (std::size_t i = 0; i < contents.size(); ++i) {
+      paths_.push_back((directory / ("hello_tf_string_bench_" + std::to_string(i) + ".bin")).string());
+      std::ofstream(paths_.back(), std::ios::binary).write(contents[i].data(), static_cast<std::streamsize>(contents[i].size()));
+    }
+  }
+
+  TempFiles(const TempFiles&) = delete;
+
+  TempFiles& operator=(const TempFiles&) = delete;
+
+  ~TempFiles() {
+    for (const auto& path : paths_) {
+      std::error_code error;
+      std::filesystem::remove(path, error);
+    }
+  }
+
+  const std::vector<std::string>& paths() const {
+    return paths_;
+  }
+
+ private:
+  std::vector<std::string> paths_;
+};
+
+template <typename Create>
+bool Measure(StringGraph& graph, std::size_t count, std::size_t repetitions, Create create, BenchResult& result) {
+  const std::vector<std::int64_t> dims = {static_cast<std::int64_t>(count)};
+
+  for (std::size_t i = 0; i < repetitions + 1; ++i) { // The first repetition is a warmup.
+    const bool record = i != 0;
+
+    auto allocations = bench::AllocationCount();
+    bench::Stopwatch stopwatch;
+    TF_Tensor* input = create(dims);
+    const auto create_ns = stopwatch.ElapsedNanoseconds();
+    const auto create_allocations = bench::AllocationCount() - allocations;
+    SCOPE_EXIT{ tf_utils::DeleteTensor(input); };
+    if (input == nullptr) {
+      std::cout << "Failed to create string tensor" << std::endl;
+      return false;
+    }
+
+    TF_Tensor* output = nullptr;
+    allocations = bench::AllocationCount();
+    stopwatch.Restart();
+    const auto code = graph.Run(input, &output);
+    const auto run_ns = stopwatch.ElapsedNanoseconds();
+    const auto run_allocations = bench::AllocationCount() - allocations;
+    SCOPE_EXIT{ tf_utils::DeleteTensor(output); };
+    if (code != TF_OK) {
+      std::cout << "Failed to run session: " << graph.message() << std::endl;
+      return false;
+    }
+
+    allocations = bench::AllocationCount();
+    stopwatch.Restart();
+    const auto values = tf_utils::GetStringTensorData(output);
+    const auto read_ns = stopwatch.ElapsedNanoseconds();
+    const auto read_allocations = bench::AllocationCount() - allocations;
+    if (values.size() != count) {
+      std::cout << "Unexpected output element count" << std::endl;
+      return false;
+    }
+
+    if (record) {
+      result.create.nanoseconds += create_ns;
+      result.create.allocations += create_allocations;
+      result.run.nanoseconds += run_ns;
+      result.run.allocations += run_allocations;
+      result.read.nanoseconds += read_ns;
+      result.read.allocations += read_allocations;
+    }
+  }
+
+  result.repetitions = repetitions;
+  return true;
+}
+
+void PrintHeader() {
+  std::cout << std::left
+            << std::setw(12) << "mode"
+            << std::setw(8) << "length"
+            << std::right
+            << std::setw(10) << "elements"
+            << std::setw(8) << "reps"
+            << std::setw(14) << "create ns/el"
+            << std::setw(12) << "run ns/el"
+            << std::setw(12) << "read ns/el"
+            << std::setw(16) << "create alloc/el"
+            << std::setw(13) << "run alloc/el"
+            << std::setw(14) << "read alloc/el"
+            << std::endl;
+}
+
+void PrintRow(ConstructionMode mode, LengthDistribution distribution, std::size_t count, const BenchResult& result) {
+  const auto elements = static_cast<double>(count * result.repetitions);
+  std::cout << std::left
+            << std::setw(12) << ToString(mode)
+            << std::setw(8) << ToString(distribution)
+            << std::right << std::fixed
+            << std::setw(10) << count
+            << std::setw(8) << result.repetitions
+            << std::setprecision(1)
+            << std::setw(14) << result.create.nanoseconds / elements
+            << std::setw(12) << result.run.nanoseconds / elements
+            << std::setw(12) << result.read.nanoseconds / elements
+            << std::setprecision(2)
+            << std::setw(16) << static_cast<double>(result.create.allocations) / elements
+            << std::setw(13) << static_cast<double>(result.run.allocations) / elements
+            << std::setw(14) << static_cast<double>(result.read.allocations) / elements
+            << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  const bool quick = argc > 1 && std::strcmp(argv[1], "--quick") == 0;
+
+  StringGraph graph;
+  if (!graph.ok()) {
+    std::cout << "Failed to create string graph: " << graph.message() << std::endl;
+    return 1;
+  }
+
+  const std::vector<std::size_t> counts = quick ? std::vector<std::size_t>{1, 64} : std::vector<std::size_t>{1, 64, 1024, 16384};
+  const std::vector<LengthDistribution> distributions = {LengthDistribution::Sso, LengthDistribution::Medium, LengthDistribution::Large};
+  const std::vector<ConstructionMode> modes = {ConstructionMode::OwnedStrings, ConstructionMode::StringViews, ConstructionMode::Files};
+  const std::size_t elements_per_config = quick ? 256 : 64 * 1024;
+  const std::size_t max_bytes_per_config = quick ? (16u << 20) : (1024u << 20);
+  const std::size_t max_file_count = 1024;
+
+  std::cout << "TensorFlow " << TF_Version() << ", allocation counter: "
+            << (bench::CountsMallocAllocations() ? "malloc (process-wide)" : "operator new only") << std::endl;
+  PrintHeader();
+
+  for (const auto distribution : distributions) {
+    for (const auto count : counts) {
+      const auto strings = MakeStrings(distribution, count);
+      std::size_t total_bytes = 0;
+      for (const auto& str : strings) {
+        total_bytes += str.size();
+      }
+
+      auto repetitions = std::max<std::size_t>(3, elements_per_config / count);
+      if (total_bytes != 0) {
+        repetitions = std::max<std::size_t>(1, std::min(repetitions, max_bytes_per_config / total_bytes));
+      }
+
+      const std::vector<std::string_view> views(strings.begin(), strings.end());
+      for (const auto mode : modes) {
+        if (mode == ConstructionMode::Files && count > max_file_count) {
+          continue;
+        }
+
+        BenchResult result;
+        bool ok = false;
+        switch (mode) {
+          case ConstructionMode::OwnedStrings:
+            ok = Measure(graph, count, repetitions, [&strings](const std::vector<std::int64_t>& dims) {
+              return tf_utils::CreateStringTensor(dims, strings);
+            }, result);
+            break;
+          case ConstructionMode::StringViews:
+            ok = Measure(graph, count, repetitions, [&views](const std::vector<std::int64_t>& dims) {
+              return tf_utils::CreateStringTensor(dims, views);
+            }, result);
+            break;
+          case ConstructionMode::Files: {
+            const TempFiles files(strings);
+            ok = Measure(graph, count, repetitions, [&files](const std::vector<std::int64_t>& dims) {
+              return tf_utils::CreateStringTensorFromFiles(dims, files.paths());
+            }, result);
+            break;
+          }
+        }
+        if (!ok) {
+          return 2;
+        }
+
+        PrintRow(mode, distribution, count, result);
+      }
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,306 @@
+// Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2018 - 2026 Daniil Goncharov <neargye@gmail.com>.
+//
+// Permission is hereby  granted, free of charge, to any  person obtaining a copy
+// of this software and associated  documentation files (the "Software"), to deal
+// in the Software  without restriction, including without  limitation the rights
+// to  use, copy,  modify, merge,  publish, distribute,  sublicense, and/or  sell
+// copies  of  the Software,  and  to  permit persons  to  whom  the Software  is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE  IS PROVIDED "AS  IS", WITHOUT WARRANTY  OF ANY KIND,  EXPRESS OR
+// IMPLIED,  INCLUDING BUT  NOT  LIMITED TO  THE  WARRANTIES OF  MERCHANTABILITY,
+// FITNESS FOR  A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT  SHALL THE
+// AUTHORS  OR COPYRIGHT  HOLDERS  BE  LIABLE FOR  ANY  CLAIM,  DAMAGES OR  OTHER
+// LIABILITY, WHETHER IN AN ACTION OF  CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE  OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "bench_utils.hpp"
+#include "tf_utils.hpp"
+#include <scope_guard.hpp>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+enum class JitMode {
+  Default, // Session options left at TensorFlow's defaults.
+  XlaCpu,  // global_jit_level ON_1 with cpu_global_jit, so CPU subgraphs are clustered and compiled by XLA.
+};
+
+const char* ToString(JitMode mode) {
+  switch (mode) {
+    case JitMode::Default:
+      return "default";
+    case JitMode::XlaCpu:
+      return "xla";
+  }
+  return "unknown";
+}
+
+struct Model {
+  std::string name;
+  TF_Graph* graph = nullptr;
+  TF_Output input{nullptr, 0};
+  TF_Output output{nullptr, 0};
+  std::vector<std::int64_t> input_dims;
+};
+
+struct BenchResult {
+  double compile_ms = 0.0;
+  std::size_t runs = 0;
+  double seconds = 0.0;
+  double p50_us = 0.0;
+  double p99_us = 0.0;
+};
+
+TF_Operation* AddFloatConst(TF_Graph* graph, const std::string& name, float value, TF_Status* status) {
+  auto tensor = tf_utils::CreateTensor(TF_FLOAT, std::vector<std::int64_t>{}, std::vector<float>{value});
+  SCOPE_EXIT{ tf_utils::DeleteTensor(tensor); };
+  if (tensor == nullptr) {
+    return nullptr;
+  }
+
+  auto desc = TF_NewOperation(graph, "Const", name.c_str());
+  TF_SetAttrType(desc, "dtype", TF_FLOAT);
+  TF_SetAttrTensor(desc, "value", tensor, status);
+  if (TF_GetCode(status) != TF_OK) {
+    return nullptr;
+  }
+
+  return TF_FinishOperation(desc, status);
+}
+
+TF_Operation* AddUnaryOp(TF_Graph* graph, const char* type, const std::string& name, TF_Output x, TF_Status* status) {
+  auto desc = TF_NewOperation(graph, type, name.c_str());
+  TF_SetAttrType(desc, "T", TF_FLOAT);
+  TF_AddInput(desc, x);
+
+  return TF_FinishOperation(desc, status);
+}
+
+TF_Operation* AddBinaryOp(TF_Graph* graph, const char* type, const std::string& name, TF_Output x, TF_Output y, TF_Status* status) {
+  auto desc = TF_NewOperation(graph, type, name.c_str());
+  TF_SetAttrType(desc, "T", TF_FLOAT);
+  TF_AddInput(desc, x);
+  TF_AddInput(desc, y);
+
+  return TF_FinishOperation(desc, status);
+}
+
+// Builds depth layers of tanh(x * scale + bias) over a [batch, width] input: the kind of element-wise chain
+// that runs as one kernel per op by default and as a single fused kernel under XLA.
+bool CreateElementwiseChain(std::size_t depth, std::int64_t batch, std::int64_t width, Model& model) {
+  auto status = TF_NewStatus();
+  SCOPE_EXIT{ TF_DeleteStatus(status); };
+
+  model.name = "chain x" + std::to_string(depth);
+  model.graph = TF_NewGraph();
+  model.input_dims = {batch, width};
+
+  auto desc = TF_NewOperation(model.graph, "Placeholder", "input");
+  TF_SetAttrType(desc, "dtype", TF_FLOAT);
+  TF_SetAttrShape(desc, "shape", model.input_dims.data(), static_cast<int>(model.input_dims.size()));
+  auto input = TF_FinishOperation(desc, status);
+  if (TF_GetCode(status) != TF_OK) {
+    return false;
+  }
+
+  auto scale = AddFloatConst(model.graph, "scale", 0.5f, status);
+  if (TF_GetCode(status) != TF_OK) {
+    return false;
+  }
+  auto bias = AddFloatConst(model.graph, "bias", 0.25f, status);
+  if (TF_GetCode(status) != TF_OK) {
+    return false;
+  }
+
+  TF_Output x{input, 0};
+  for (std::size_t layer = 0; layer < depth; ++layer) {
+    const auto suffix = std::to_string(layer);
+    auto mul = AddBinaryOp(model.graph, "Mul", "mul_" + suffix, x, TF_Output{scale, 0}, status);
+    if (TF_GetCode(status) != TF_OK) {
+      return false;
+    }
+    auto add = AddBinaryOp(model.graph, "AddV2", "add_" + suffix, TF_Output{mul, 0}, TF_Output{bias, 0}, status);
+    if (TF_GetCode(status) != TF_OK) {
+      return false;
+    }
+    auto tanh = AddUnaryOp(model.graph, "Tanh", "tanh_" + suffix, TF_Output{add, 0}, status);
+    if (TF_GetCode(status) != TF_OK) {
+      return false;
+    }
+    x = TF_Output{tanh, 0};
+  }
+
+  model.input = TF_Output{input, 0};
+  model.output = x;
+  return true;
+}
+
+TF_SessionOptions* CreateSessionOptions(JitMode mode) {
+  tf_utils::SessionConfigBuilder builder;
+  if (mode == JitMode::XlaCpu) {
+    builder.SetGlobalJitLevel(tf_utils::GlobalJitLevel::On1).SetCpuGlobalJit(true);
+  }
+
+  return builder.CreateSessionOptions();
+}
+
+bool RunModel(const Model& model, JitMode mode, std::size_t warmup_runs, std::size_t iterations, BenchResult& result) {
+  auto options = CreateSessionOptions(mode);
+  SCOPE_EXIT{ tf_utils::DeleteSessionOptions(options); };
+  if (options == nullptr) {
+    return false;
+  }
+
+  auto session = tf_utils::CreateSession(model.graph, options);
+  SCOPE_EXIT{ tf_utils::DeleteSession(session); };
+  if (session == nullptr) {
+    return false;
+  }
+
+  std::size_t element_count = 1;
+  for (const auto dim : model.input_dims) {
+    element_count *= static_cast<std::size_t>(dim);
+  }
+  const std::vector<TF_Tensor*> input_tensors = {tf_utils::CreateTensor(TF_FLOAT, model.input_dims, std::vector<float>(element_count, 1.0f))};
+  SCOPE_EXIT{ tf_utils::DeleteTensors(input_tensors); };
+  if (input_tensors[0] == nullptr) {
+    return false;
+  }
+
+  std::vector<TF_Tensor*> output_tensors = {nullptr};
+  const auto run_once = [&] {
+    const auto code = tf_utils::RunSession(session, &model.input, input_tensors.data(), 1, &model.output, output_tensors.data(), 1);
+    tf_utils::DeleteTensors(output_tensors);
+    output_tensors.assign(1, nullptr);
+    return code == TF_OK;
+  };
+
+  // The first run pays graph optimization and, with XLA, cluster compilation.
+  bench::Stopwatch stopwatch;
+  if (!run_once()) {
+    return false;
+  }
+  result.compile_ms = stopwatch.ElapsedNanoseconds() / 1.0e6;
+  for (std::size_t i = 1; i < warmup_runs; ++i) {
+    if (!run_once()) {
+      return false;
+    }
+  }
+
+  std::vector<double> latencies;
+  latencies.reserve(iterations);
+  stopwatch.Restart();
+  for (std::size_t i = 0; i < iterations; ++i) {
+    bench::Stopwatch run_stopwatch;
+    if (!run_once()) {
+      return false;
+    }
+    latencies.push_back(run_stopwatch.ElapsedNanoseconds() / 1000.0);
+  }
+  result.seconds = stopwatch.ElapsedNanoseconds() / 1.0e9;
+  result.runs = latencies.size();
+  result.p50_us = bench::Percentile(latencies, 50.0);
+  result.p99_us = bench::Percentile(latencies, 99.0);
+
+  return true;
+}
+
+void PrintHeader() {
+  std::cout << std::left
+            << std::setw(14) << "model"
+            << std::setw(10) << "mode"
+            << std::right
+            << std::setw(14) << "warmup ms"
+            << std::setw(10) << "runs"
+            << std::setw(12) << "runs/s"
+            << std::setw(12) << "p50 us"
+            << std::setw(12) << "p99 us"
+            << std::endl;
+}
+
+void PrintRow(const Model& model, JitMode mode, const BenchResult& result) {
+  const auto throughput = result.seconds > 0.0 ? static_cast<double>(result.runs) / result.seconds : 0.0;
+  std::cout << std::left
+            << std::setw(14) << model.name
+            << std::setw(10) << ToString(mode)
+            << std::right << std::fixed
+            << std::setprecision(1)
+            << std::setw(14) << result.compile_ms
+            << std::setw(10) << result.runs
+            << std::setprecision(0)
+            << std::setw(12) << throughput
+            << std::setprecision(1)
+            << std::setw(12) << result.p50_us
+            << std::setw(12) << result.p99_us
+            << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  const bool quick = argc > 1 && std::strcmp(argv[1], "--quick") == 0;
+
+  std::vector<Model> models(1);
+  SCOPE_EXIT{
+    for (auto& model : models) {
+      tf_utils::DeleteGraph(model.graph);
+    }
+  };
+
+  models[0].name = "graph.pb";
+  models[0].graph = tf_utils::LoadGraph("graph.pb");
+  if (models[0].graph == nullptr) {
+    std::cout << "Failed to load graph" << std::endl;
+    return 1;
+  }
+  models[0].input = TF_Output{TF_GraphOperationByName(models[0].graph, "input_4"), 0};
+  models[0].output = TF_Output{TF_GraphOperationByName(models[0].graph, "output_node0"), 0};
+  models[0].input_dims = {1, 5, 12};
+  if (models[0].input.oper == nullptr || models[0].output.oper == nullptr) {
+    std::cout << "Failed to find input or output operation" << std::endl;
+    return 2;
+  }
+
+  const std::vector<std::size_t> depths = quick ? std::vector<std::size_t>{4} : std::vector<std::size_t>{16, 64, 256};
+  const std::int64_t batch = quick ? 2 : 32;
+  const std::int64_t width = quick ? 16 : 1024;
+  for (const auto depth : depths) {
+    models.emplace_back();
+    if (!CreateElementwiseChain(depth, batch, width, models.back())) {
+      std::cout << "Failed to build synthetic graph with " << depth << " layers" << std::endl;
+      return 3;
+    }
+  }
+
+  const std::size_t warmup_runs = quick ? 2 : 10;
+  const std::size_t iterations = quick ? 20 : 2000;
+
+  std::cout << "TensorFlow " << TF_Version() << ", synthetic input: [" << batch << ", " << width << "]" << std::endl;
+  PrintHeader();
+
+  for (const auto& model : models) {
+    for (const auto mode : {JitMode::Default, JitMode::XlaCpu}) {
+      BenchResult result;
+      if (!RunModel(model, mode, warmup_runs, iterations, result)) {
+        std::cout << "Failed to run " << model.name << " with " << ToString(mode) << " session options" << std::endl;
+        return 4;
+      }
+
+      PrintRow(model, mode, result);
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,262 @@
+// Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2018 - 2026 Daniil Goncharov <neargye@gmail.com>.
+//
+// Permission is hereby  granted, free of charge, to any  person obtaining a copy
+// of this software and associated  documentation files (the "Software"), to deal
+// in the Software  without restriction, including without  limitation the rights
+// to  use, copy,  modify, merge,  publish, distribute,  sublicense, and/or  sell
+// copies  of  the Software,  and  to  permit persons  to  whom  the Software  is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE  IS PROVIDED "AS  IS", WITHOUT WARRANTY  OF ANY KIND,  EXPRESS OR
+// IMPLIED,  INCLUDING BUT  NOT  LIMITED TO  THE  WARRANTIES OF  MERCHANTABILITY,
+// FITNESS FOR  A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT  SHALL THE
+// AUTHORS  OR COPYRIGHT  HOLDERS  BE  LIABLE FOR  ANY  CLAIM,  DAMAGES OR  OTHER
+// LIABILITY, WHETHER IN AN ACTION OF  CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE  OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "tf_utils.hpp"
+#include <scope_guard.hpp>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr std::size_t token_width = 16;
+
+TF_Operation* FinishOperation(TF_OperationDescription* desc, TF_Status* status) {
+  auto op = TF_FinishOperation(desc, status);
+  if (TF_GetCode(status) != TF_OK) {
+    std::cout << "Failed to finish operation: " << TF_Message(status) << std::endl;
+    return nullptr;
+  }
+
+  return op;
+}
+
+TF_Operation* AddPlaceholder(TF_Graph* graph, const char* name, TF_DataType data_type, TF_Status* status) {
+  auto desc = TF_NewOperation(graph, "Placeholder", name);
+  TF_SetAttrType(desc, "dtype", data_type);
+
+  return FinishOperation(desc, status);
+}
+
+TF_Operation* AddConst(TF_Graph* graph, const char* name, TF_Tensor* tensor, TF_Status* status) {
+  if (tensor == nullptr) {
+    return nullptr;
+  }
+
+  auto desc = TF_NewOperation(graph, "Const", name);
+  TF_SetAttrType(desc, "dtype", TF_TensorType(tensor));
+  TF_SetAttrTensor(desc, "value", tensor, status);
+  if (TF_GetCode(status) != TF_OK) {
+    std::cout << "Failed to set const tensor: " << TF_Message(status) << std::endl;
+    return nullptr;
+  }
+
+  return FinishOperation(desc, status);
+}
+
+// 256 single-byte strings followed by an empty string used for padding positions.
+TF_Operation* AddByteTable(TF_Graph* graph, TF_Status* status) {
+  std::vector<std::string> table;
+  table.reserve(257);
+  for (int i = 0; i < 256; ++i) {
+    table.emplace_back(1, static_cast<char>(i));
+  }
+  table.emplace_back();
+
+  auto tensor = tf_utils::CreateStringTensor({257}, table);
+  SCOPE_EXIT{ tf_utils::DeleteTensor(tensor); };
+
+  return AddConst(graph, "byte_table", tensor, status);
+}
+
+TF_Operation* AddInt32Const(TF_Graph* graph, const char* name, const std::vector<std::int64_t>& dims, const std::vector<std::int32_t>& values, TF_Status* status) {
+  auto tensor = tf_utils::CreateTensor(TF_INT32, dims, values);
+  SCOPE_EXIT{ tf_utils::DeleteTensor(tensor); };
+
+  return AddConst(graph, name, tensor, status);
+}
+
+TF_Operation* AddCastToInt32(TF_Graph* graph, TF_Output input, TF_Status* status) {
+  auto desc = TF_NewOperation(graph, "Cast", "bytes_to_int32");
+  TF_AddInput(desc, input);
+  TF_SetAttrType(desc, "SrcT", TF_UINT8);
+  TF_SetAttrType(desc, "DstT", TF_INT32);
+  TF_SetAttrBool(desc, "Truncate", static_cast<unsigned char>(0));
+
+  return FinishOperation(desc, status);
+}
+
+TF_Operation* AddExpandDims(TF_Graph* graph, const char* name, TF_Output input, TF_Output axis, TF_Status* status) {
+  auto desc = TF_NewOperation(graph, "ExpandDims", name);
+  TF_AddInput(desc, input);
+  TF_AddInput(desc, axis);
+  TF_SetAttrType(desc, "T", TF_INT32);
+  TF_SetAttrType(desc, "Tdim", TF_INT32);
+
+  return FinishOperation(desc, status);
+}
+
+TF_Operation* AddLess(TF_Graph* graph, const char* name, TF_Output lhs, TF_Output rhs, TF_Status* status) {
+  auto desc = TF_NewOperation(graph, "Less", name);
+  TF_AddInput(desc, lhs);
+  TF_AddInput(desc, rhs);
+  TF_SetAttrType(desc, "T", TF_INT32);
+
+  return FinishOperation(desc, status);
+}
+
+TF_Operation* AddSelect(TF_Graph* graph, const char* name, TF_Output condition, TF_Output then_value, TF_Output else_value, TF_Status* status) {
+  auto desc = TF_NewOperation(graph, "SelectV2", name);
+  TF_AddInput(desc, condition);
+  TF_AddInput(desc, then_value);
+  TF_AddInput(desc, else_value);
+  TF_SetAttrType(desc, "T", TF_INT32);
+
+  return FinishOperation(desc, status);
+}
+
+TF_Operation* AddGather(TF_Graph* graph, const char* name, TF_Output params, TF_Output indices, TF_Output axis, TF_Status* status) {
+  auto desc = TF_NewOperation(graph, "GatherV2", name);
+  TF_AddInput(desc, params);
+  TF_AddInput(desc, indices);
+  TF_AddInput(desc, axis);
+  TF_SetAttrType(desc, "Tparams", TF_STRING);
+  TF_SetAttrType(desc, "Tindices", TF_INT32);
+  TF_SetAttrType(desc, "Taxis", TF_INT32);
+
+  return FinishOperation(desc, status);
+}
+
+TF_Operation* AddReduceJoin(TF_Graph* graph, const char* name, TF_Output input, TF_Output axis, TF_Status* status) {
+  auto desc = TF_NewOperation(graph, "ReduceJoin", name);
+  TF_AddInput(desc, input);
+  TF_AddInput(desc, axis);
+  TF_SetAttrBool(desc, "keep_dims", static_cast<unsigned char>(0));
+  TF_SetAttrString(desc, "separator", "", 0);
+
+  return FinishOperation(desc, status);
+}
+
+// Converts packed [batch, token_width] bytes plus [batch] lengths back to [batch] TF_STRING in-graph:
+// each byte selects a one-byte string from a table, padding selects the empty string, and rows are joined.
+TF_Operation* AddUnpackFixedWidthStrings(TF_Graph* graph, TF_Output bytes, TF_Output lengths, TF_Status* status) {
+  auto byte_table = AddByteTable(graph, status);
+  if (byte_table == nullptr) {
+    return nullptr;
+  }
+
+  std::vector<std::int32_t> position_values(token_width);
+  for (std::size_t i = 0; i < token_width; ++i) {
+    position_values[i] = static_cast<std::int32_t>(i);
+  }
+  auto positions = AddInt32Const(graph, "positions", {static_cast<std::int64_t>(token_width)}, position_values, status);
+  auto padding_index = AddInt32Const(graph, "padding_index", {}, {256}, status);
+  auto zero = AddInt32Const(graph, "zero", {}, {0}, status);
+  auto one = AddInt32Const(graph, "one", {}, {1}, status);
+  if (positions == nullptr || padding_index == nullptr || zero == nullptr || one == nullptr) {
+    return nullptr;
+  }
+
+  auto byte_indices = AddCastToInt32(graph, bytes, status);
+  if (byte_indices == nullptr) {
+    return nullptr;
+  }
+
+  auto row_lengths = AddExpandDims(graph, "row_lengths", lengths, TF_Output{one, 0}, status);
+  if (row_lengths == nullptr) {
+    return nullptr;
+  }
+
+  auto mask = AddLess(graph, "valid_bytes", TF_Output{positions, 0}, TF_Output{row_lengths, 0}, status);
+  if (mask == nullptr) {
+    return nullptr;
+  }
+
+  auto indices = AddSelect(graph, "table_indices", TF_Output{mask, 0}, TF_Output{byte_indices, 0}, TF_Output{padding_index, 0}, status);
+  if (indices == nullptr) {
+    return nullptr;
+  }
+
+  auto characters = AddGather(graph, "characters", TF_Output{byte_table, 0}, TF_Output{indices, 0}, TF_Output{zero, 0}, status);
+  if (characters == nullptr) {
+    return nullptr;
+  }
+
+  return AddReduceJoin(graph, "tokens", TF_Output{characters, 0}, TF_Output{one, 0}, status);
+}
+
+} // namespace
+
+int main() {
+  const std::vector<std::string> tokens = {"hello", "tensorflow", "", std::string("a\0b", 3)};
+
+  auto status = TF_NewStatus();
+  SCOPE_EXIT{ TF_DeleteStatus(status); };
+
+  auto graph = TF_NewGraph();
+  SCOPE_EXIT{ tf_utils::DeleteGraph(graph); };
+
+  auto bytes_input = AddPlaceholder(graph, "token_bytes", TF_UINT8, status);
+  if (bytes_input == nullptr) {
+    return 1;
+  }
+
+  auto lengths_input = AddPlaceholder(graph, "token_lengths", TF_INT32, status);
+  if (lengths_input == nullptr) {
+    return 2;
+  }
+
+  auto output = AddUnpackFixedWidthStrings(graph, TF_Output{bytes_input, 0}, TF_Output{lengths_input, 0}, status);
+  if (output == nullptr) {
+    return 3;
+  }
+
+  TF_Tensor* bytes_tensor = nullptr;
+  TF_Tensor* lengths_tensor = nullptr;
+  if (!tf_utils::CreateFixedWidthStringTensors(tokens, token_width, &bytes_tensor, &lengths_tensor)) {
+    std::cout << "Failed to pack fixed-width tokens" << std::endl;
+    return 4;
+  }
+  SCOPE_EXIT{ tf_utils::DeleteTensor(bytes_tensor); };
+  SCOPE_EXIT{ tf_utils::DeleteTensor(lengths_tensor); };
+
+  auto session = tf_utils::CreateSession(graph, status);
+  SCOPE_EXIT{ tf_utils::DeleteSession(session); };
+  if (session == nullptr || TF_GetCode(status) != TF_OK) {
+    std::cout << "Failed to create session: " << TF_Message(status) << std::endl;
+    return 5;
+  }
+
+  const std::vector<TF_Output> inputs = {TF_Output{bytes_input, 0}, TF_Output{lengths_input, 0}};
+  const std::vector<TF_Tensor*> input_tensors = {bytes_tensor, lengths_tensor};
+  const std::vector<TF_Output> outputs = {TF_Output{output, 0}};
+  std::vector<TF_Tensor*> output_tensors = {nullptr};
+  SCOPE_EXIT{ tf_utils::DeleteTensors(output_tensors); };
+
+  auto code = tf_utils::RunSession(session, inputs, input_tensors, outputs, output_tensors, status);
+  if (code != TF_OK) {
+    std::cout << "Failed to run session: " << TF_Message(status) << std::endl;
+    return 6;
+  }
+
+  const auto result = tf_utils::GetStringTensorData(output_tensors[0]);
+  if (result != tokens) {
+    std::cout << "Unpacked tokens do not match" << std::endl;
+    return 7;
+  }
+
+  std::cout << "Packed " << tokens.size() << " tokens into " << token_width << " bytes each" << std::endl;
+  std::cout << "Unpacked tokens in-graph successfully" << std::endl;
+
+  return 0;
+}
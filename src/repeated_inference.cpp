@@ -22,8 +22,10 @@
 
 #include "tf_utils.hpp"
 #include <scope_guard.hpp>
+#include <array>
 #include <cmath>
 #include <cstdint>
+#include <cstring>
 #include <iostream>
 #include <vector>
 
@@ -35,18 +37,6 @@ int main() {
     return 1;
   }
 
-  const auto input = TF_Output{TF_GraphOperationByName(graph, "input_4"), 0};
-  if (input.oper == nullptr) {
-    std::cout << "Failed to find input operation" << std::endl;
-    return 2;
-  }
-
-  const auto output = TF_Output{TF_GraphOperationByName(graph, "output_node0"), 0};
-  if (output.oper == nullptr) {
-    std::cout << "Failed to find output operation" << std::endl;
-    return 3;
-  }
-
   auto status = TF_NewStatus();
   SCOPE_EXIT{ TF_DeleteStatus(status); };
 
@@ -54,7 +44,15 @@ int main() {
   SCOPE_EXIT{ tf_utils::DeleteSession(session); };
   if (session == nullptr || TF_GetCode(status) != TF_OK) {
     std::cout << "Failed to create session: " << TF_Message(status) << std::endl;
-    return 4;
+    return 2;
+  }
+
+  // Resolve operations and check counts once; each Run below only feeds the tensor and collects the output.
+  auto run = tf_utils::CreatePreparedRun(session, graph, {"input_4"}, {"output_node0"}, {}, status);
+  SCOPE_EXIT{ tf_utils::DeletePreparedRun(run); };
+  if (run == nullptr) {
+    std::cout << "Failed to prepare run: " << TF_Message(status) << std::endl;
+    return 3;
   }
 
   const std::vector<std::int64_t> input_dims = {1, 5, 12};
@@ -63,14 +61,10 @@ int main() {
   SCOPE_EXIT{ tf_utils::DeleteTensor(input_tensor); };
   if (input_tensor == nullptr) {
     std::cout << "Failed to create input tensor" << std::endl;
-    return 5;
+    return 4;
   }
 
-  const std::vector<TF_Output> inputs = {input};
-  const std::vector<TF_Tensor*> input_tensors = {input_tensor};
-  const std::vector<TF_Output> outputs = {output};
-
-  std::vector<float> last_result;
+  std::array<float, 4> last_result = {};
   for (int iteration = 0; iteration < 10; ++iteration) {
     for (std::size_t i = 0; i < input_values.size(); ++i) {
       input_values[i] = static_cast<float>(iteration) + static_cast<float>(i) / 100.0f;
@@ -78,27 +72,24 @@ int main() {
 
     if (!tf_utils::SetTensorData(input_tensor, input_values)) {
       std::cout << "Failed to update input tensor" << std::endl;
-      return 6;
+      return 5;
     }
 
-    std::vector<TF_Tensor*> output_tensors = {nullptr};
-    SCOPE_EXIT{ tf_utils::DeleteTensors(output_tensors); };
-
-    const auto code = tf_utils::RunSession(session, inputs, input_tensors, outputs, output_tensors, status);
-    if (code != TF_OK) {
-      std::cout << "Failed to run session: " << TF_Message(status) << std::endl;
-      return 7;
+    if (run->Run(&input_tensor) != TF_OK) {
+      std::cout << "Failed to run session: " << run->message() << std::endl;
+      return 6;
     }
 
-    last_result = tf_utils::GetTensorData<float>(output_tensors[0]);
-    if (last_result.size() != 4) {
+    const auto output_tensor = run->output(0);
+    if (TF_TensorType(output_tensor) != TF_FLOAT || TF_TensorByteSize(output_tensor) != sizeof(last_result)) {
       std::cout << "Unexpected output tensor size" << std::endl;
-      return 8;
+      return 7;
     }
+    std::memcpy(last_result.data(), TF_TensorData(output_tensor), sizeof(last_result));
     for (const auto value : last_result) {
       if (!std::isfinite(value)) {
         std::cout << "Unexpected output tensor value" << std::endl;
-        return 9;
+        return 8;
       }
     }
   }
@@ -21,20 +21,45 @@
 // SOFTWARE.
 
 #include "tf_utils.hpp"
+#include <arrow/c/abi.h>
 #include <scope_guard.hpp>
 #include <algorithm>
 #include <array>
+#include <cctype>
 #include <cmath>
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
 #include <filesystem>
 #include <fstream>
+#include <functional>
 #include <limits>
 #include <memory>
+#include <random>
+#include <string>
 #include <system_error>
+#include <utility>
 #include <vector>
 
+#if defined(_WIN32)
+#  if !defined(WIN32_LEAN_AND_MEAN)
+#    define WIN32_LEAN_AND_MEAN
+#  endif
+#  if !defined(NOMINMAX)
+#    define NOMINMAX
+#  endif
+#  include <windows.h>
+#else
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <unistd.h>
+#endif
+
+#if defined(__linux__)
+#  include <sched.h>
+#  include <sys/syscall.h>
+#endif
+
 namespace tf_utils {
 
 namespace {
@@ -43,8 +68,86 @@ static void DeallocateBuffer(void* data, size_t) {
   std::free(data);
 }
 
+// Files smaller than this are copied into the string tensor; mapping them costs more than reading.
+constexpr std::size_t min_mapped_file_size = 64 * 1024;
+
+struct MappedFile {
+  MappedFile() = default;
+
+  MappedFile(const MappedFile&) = delete;
+
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  MappedFile(MappedFile&& other) noexcept
+      : data(other.data), size(other.size) {
+    other.data = nullptr;
+    other.size = 0;
+  }
+
+  MappedFile& operator=(MappedFile&&) = delete;
+
+  ~MappedFile() {
+    unmap();
+  }
+
+  bool map(const char* file, std::size_t file_size) {
+    if (file == nullptr || file_size == 0) {
+      return false;
+    }
+
+#if defined(_WIN32)
+    auto handle = ::CreateFileA(file, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (handle == INVALID_HANDLE_VALUE) {
+      return false;
+    }
+    auto mapping = ::CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    ::CloseHandle(handle);
+    if (mapping == nullptr) {
+      return false;
+    }
+    auto view = ::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, file_size);
+    ::CloseHandle(mapping);
+    if (view == nullptr) {
+      return false;
+    }
+#else
+    const auto fd = ::open(file, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      return false;
+    }
+    auto view = ::mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (view == MAP_FAILED) {
+      return false;
+    }
+#endif
+
+    data = static_cast<const char*>(view);
+    size = file_size;
+    return true;
+  }
+
+  void unmap() {
+    if (data == nullptr) {
+      return;
+    }
+
+#if defined(_WIN32)
+    ::UnmapViewOfFile(data);
+#else
+    ::munmap(const_cast<char*>(data), size);
+#endif
+    data = nullptr;
+    size = 0;
+  }
+
+  const char* data = nullptr;
+  std::size_t size = 0;
+};
+
 struct StringTensorDeallocatorArg {
   std::size_t size;
+  std::vector<MappedFile> mapped_files; // Released after the strings that view them.
 };
 
 struct StringTensorStorage {
@@ -137,6 +240,23 @@ static TF_Code InvalidArgument(TF_Status* status, const char* message) {
   return TF_INVALID_ARGUMENT;
 }
 
+// One TF_Status per thread, created on first use and deleted when the thread exits. Entry points use it when the
+// caller passes no status, so steady-state calls do not allocate one; every TF_* call overwrites it.
+static TF_Status* ThreadLocalStatus() {
+  struct StatusHolder {
+    ~StatusHolder() {
+      if (status != nullptr) {
+        TF_DeleteStatus(status);
+      }
+    }
+
+    TF_Status* status = TF_NewStatus();
+  };
+  thread_local StatusHolder holder;
+
+  return holder.status;
+}
+
 static void StoreLittleEndianDouble(double value, std::array<std::uint8_t, sizeof(double)>& output) {
   static_assert(sizeof(double) == sizeof(std::uint64_t), "Unexpected double size.");
   static_assert(std::numeric_limits<double>::is_iec559, "CreateSessionOptions requires IEEE 754 doubles.");
@@ -152,9 +272,10 @@ enum class ProtobufWireType : std::uint32_t {
   Varint = 0,
   Fixed64 = 1,
   LengthDelimited = 2,
+  Fixed32 = 5,
 };
 
-static void AppendProtobufVarint(std::uint32_t value, std::vector<std::uint8_t>& output) {
+static void AppendProtobufVarint(std::uint64_t value, std::vector<std::uint8_t>& output) {
   while (value >= 0x80u) {
     output.push_back(static_cast<std::uint8_t>((value & 0x7fu) | 0x80u));
     value >>= 7u;
@@ -168,7 +289,13 @@ static void AppendProtobufKey(std::uint32_t field_number, ProtobufWireType wire_
 
 static void AppendProtobufInt32Field(std::uint32_t field_number, std::int32_t value, std::vector<std::uint8_t>& output) {
   AppendProtobufKey(field_number, ProtobufWireType::Varint, output);
-  AppendProtobufVarint(static_cast<std::uint32_t>(value), output);
+  // Negative int32 values are sign-extended to ten bytes, as protobuf encodes them.
+  AppendProtobufVarint(static_cast<std::uint64_t>(static_cast<std::int64_t>(value)), output);
+}
+
+static void AppendProtobufInt64Field(std::uint32_t field_number, std::int64_t value, std::vector<std::uint8_t>& output) {
+  AppendProtobufKey(field_number, ProtobufWireType::Varint, output);
+  AppendProtobufVarint(static_cast<std::uint64_t>(value), output);
 }
 
 static void AppendProtobufBoolField(std::uint32_t field_number, bool value, std::vector<std::uint8_t>& output) {
@@ -176,6 +303,12 @@ static void AppendProtobufBoolField(std::uint32_t field_number, bool value, std:
   output.push_back(value ? std::uint8_t{1} : std::uint8_t{0});
 }
 
+static void AppendProtobufStringField(std::uint32_t field_number, std::string_view value, std::vector<std::uint8_t>& output) {
+  AppendProtobufKey(field_number, ProtobufWireType::LengthDelimited, output);
+  AppendProtobufVarint(value.size(), output);
+  output.insert(output.end(), value.begin(), value.end());
+}
+
 static void AppendProtobufFixed64Field(std::uint32_t field_number,
                                         const std::array<std::uint8_t, sizeof(double)>& value,
                                         std::vector<std::uint8_t>& output) {
@@ -191,14 +324,82 @@ static void AppendProtobufMessageField(std::uint32_t field_number,
   output.insert(output.end(), message.begin(), message.end());
 }
 
-static bool FileSizeForBuffer(const char* file, std::size_t& size) {
+struct ProtobufField {
+  std::uint32_t number = 0;
+  ProtobufWireType wire_type = ProtobufWireType::Varint;
+  std::uint64_t value = 0; // Varint and fixed-width payloads.
+  const std::uint8_t* data = nullptr; // Length-delimited payloads.
+  std::size_t size = 0;
+};
+
+static bool ReadProtobufVarint(const std::uint8_t*& data, const std::uint8_t* end, std::uint64_t& value) {
+  value = 0;
+  for (std::uint32_t shift = 0; shift < 64 && data != end; shift += 7) {
+    const auto byte = *data++;
+    value |= static_cast<std::uint64_t>(byte & 0x7fu) << shift;
+    if ((byte & 0x80u) == 0) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+static bool ReadProtobufFixed(const std::uint8_t*& data, const std::uint8_t* end, std::size_t size, std::uint64_t& value) {
+  if (static_cast<std::size_t>(end - data) < size) {
+    return false;
+  }
+
+  value = 0;
+  for (std::size_t i = 0; i < size; ++i) {
+    value |= static_cast<std::uint64_t>(data[i]) << (i * 8);
+  }
+  data += size;
+  return true;
+}
+
+// Reads the next field and advances data past it. Groups are not supported.
+static bool ReadProtobufField(const std::uint8_t*& data, const std::uint8_t* end, ProtobufField& field) {
+  std::uint64_t key = 0;
+  if (!ReadProtobufVarint(data, end, key) || (key >> 3u) == 0 || (key >> 3u) > std::numeric_limits<std::uint32_t>::max()) {
+    return false;
+  }
+
+  field.number = static_cast<std::uint32_t>(key >> 3u);
+  field.wire_type = static_cast<ProtobufWireType>(key & 0x7u);
+  field.value = 0;
+  field.data = nullptr;
+  field.size = 0;
+  switch (field.wire_type) {
+    case ProtobufWireType::Varint:
+      return ReadProtobufVarint(data, end, field.value);
+    case ProtobufWireType::Fixed64:
+      return ReadProtobufFixed(data, end, 8, field.value);
+    case ProtobufWireType::Fixed32:
+      return ReadProtobufFixed(data, end, 4, field.value);
+    case ProtobufWireType::LengthDelimited: {
+      std::uint64_t size = 0;
+      if (!ReadProtobufVarint(data, end, size) || size > static_cast<std::uint64_t>(end - data)) {
+        return false;
+      }
+      field.data = data;
+      field.size = static_cast<std::size_t>(size);
+      data += field.size;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+static bool FileSize(const char* file, std::size_t& size) {
   if (file == nullptr) {
     return false;
   }
 
   std::error_code error;
   const auto file_size = std::filesystem::file_size(file, error);
-  if (error || file_size == 0) {
+  if (error) {
     return false;
   }
   if (file_size > static_cast<std::uintmax_t>(std::numeric_limits<std::size_t>::max()) ||
@@ -210,6 +411,29 @@ static bool FileSizeForBuffer(const char* file, std::size_t& size) {
   return true;
 }
 
+static bool FileSizeForBuffer(const char* file, std::size_t& size) {
+  return FileSize(file, size) && size != 0;
+}
+
+// Reads the file straight into the string element's own buffer. TF_TString_ResizeUninitialized is the inline
+// ctstring.h helper that tensorflow/c/tf_tstring.h includes.
+static bool ReadFileContents(const char* file, std::size_t size, TF_TString* contents) {
+  auto data = TF_TString_ResizeUninitialized(contents, size);
+  if (size == 0) {
+    return true;
+  }
+  if (data == nullptr) {
+    return false;
+  }
+
+  std::ifstream f(file, std::ios::binary);
+  if (!f.is_open()) {
+    return false;
+  }
+
+  return static_cast<bool>(f.read(data, static_cast<std::streamsize>(size)));
+}
+
 static void CleanupSessionAfterCloseFailure(TF_Session* session) {
   auto cleanup_status = TF_NewStatus();
   if (cleanup_status == nullptr) {
@@ -242,6 +466,21 @@ static bool ExpectedTensorByteSize(TF_DataType data_type,
   return true;
 }
 
+static TF_Tensor* NewStringTensor(const std::int64_t* dims, std::size_t num_dims,
+                                  StringTensorStorage& storage,
+                                  std::unique_ptr<StringTensorDeallocatorArg>& deallocator_arg) {
+  auto tensor = TF_NewTensor(TF_STRING,
+                             dims, static_cast<int>(num_dims),
+                             storage.get(), deallocator_arg->size * sizeof(TF_TString),
+                             &DeallocateStringTensor, deallocator_arg.get());
+  if (tensor != nullptr) {
+    storage.release();
+    deallocator_arg.release();
+  }
+
+  return tensor;
+}
+
 template <typename GetString>
 TF_Tensor* CreateStringTensorImpl(const std::int64_t* dims, std::size_t num_dims, std::size_t num_strings, GetString get_string) {
   if (!FitsTensorFlowIntParameter(num_dims) || num_strings > std::numeric_limits<std::size_t>::max() / sizeof(TF_TString)) {
@@ -263,17 +502,374 @@ TF_Tensor* CreateStringTensorImpl(const std::int64_t* dims, std::size_t num_dims
     TF_StringCopy(&data[i], str_data, str.size());
   }
 
-  auto deallocator_arg = std::make_unique<StringTensorDeallocatorArg>(StringTensorDeallocatorArg{num_strings});
-  auto tensor = TF_NewTensor(TF_STRING,
-                             dims, static_cast<int>(num_dims),
-                             storage.get(), num_strings * sizeof(TF_TString),
-                             &DeallocateStringTensor, deallocator_arg.get());
-  if (tensor != nullptr) {
-    storage.release();
-    deallocator_arg.release();
+  auto deallocator_arg = std::make_unique<StringTensorDeallocatorArg>(StringTensorDeallocatorArg{num_strings, {}});
+  return NewStringTensor(dims, num_dims, storage, deallocator_arg);
+}
+
+template <typename GetPath>
+TF_Tensor* CreateStringTensorFromFilesImpl(const std::int64_t* dims, std::size_t num_dims, std::size_t num_paths, GetPath get_path) {
+  if (!FitsTensorFlowIntParameter(num_dims) || num_paths > std::numeric_limits<std::size_t>::max() / sizeof(TF_TString)) {
+    return nullptr;
   }
 
-  return tensor;
+  std::size_t element_count = 0;
+  if (!ShapeElementCount(dims, num_dims, element_count) || element_count != num_paths) {
+    return nullptr;
+  }
+
+  auto deallocator_arg = std::make_unique<StringTensorDeallocatorArg>(StringTensorDeallocatorArg{num_paths, {}});
+  deallocator_arg->mapped_files.reserve(num_paths);
+  StringTensorStorage storage(num_paths);
+  for (std::size_t i = 0; i < num_paths; ++i) {
+    auto* data = storage.get();
+    const char* path = get_path(i);
+    TF_StringInit(&data[i]);
+    storage.mark_initialized();
+
+    std::size_t file_size = 0;
+    if (!FileSize(path, file_size)) {
+      return nullptr;
+    }
+
+    if (file_size >= min_mapped_file_size) {
+      MappedFile mapped_file;
+      if (mapped_file.map(path, file_size)) {
+        TF_StringAssignView(&data[i], mapped_file.data, mapped_file.size);
+        deallocator_arg->mapped_files.push_back(std::move(mapped_file));
+        continue;
+      }
+    }
+
+    if (!ReadFileContents(path, file_size, &data[i])) {
+      return nullptr;
+    }
+  }
+
+  return NewStringTensor(dims, num_dims, storage, deallocator_arg);
+}
+
+struct ArrowArrayData {
+  ArrowArrayData() = default;
+
+  ArrowArrayData(const ArrowArrayData&) = delete;
+
+  ArrowArrayData& operator=(const ArrowArrayData&) = delete;
+
+  ~ArrowArrayData() {
+    DeleteTensor(tensor);
+  }
+
+  TF_Tensor* tensor = nullptr; // Owned; numeric exports point into its data.
+  std::vector<std::uint8_t> bitmap;
+  std::vector<std::int32_t> offsets;
+  std::vector<std::int64_t> large_offsets;
+  std::unique_ptr<char[]> bytes;
+  std::array<const void*, 3> buffers = {};
+  std::array<const void*, 1> list_buffers = {}; // fixed_size_list levels have only a (null) validity buffer.
+  std::vector<ArrowArray> children; // One per dimension after the first; the last one holds the values.
+  std::vector<ArrowArray*> child_links;
+};
+
+struct ArrowSchemaData {
+  std::vector<std::string> formats; // "+w:<size>" for each fixed_size_list level.
+  std::vector<ArrowSchema> children;
+  std::vector<ArrowSchema*> child_links;
+};
+
+// Every array and schema in an export holds its own reference to the shared data, so a consumer may move a child
+// out and release it on its own, as the C data interface allows.
+template <typename Node, typename Data>
+void ReleaseArrowNode(Node* node) {
+  if (node == nullptr || node->release == nullptr) {
+    return;
+  }
+
+  for (std::int64_t i = 0; i < node->n_children; ++i) {
+    auto child = node->children[i];
+    if (child != nullptr && child->release != nullptr) {
+      child->release(child);
+    }
+  }
+  delete static_cast<std::shared_ptr<Data>*>(node->private_data);
+  node->private_data = nullptr;
+  node->release = nullptr;
+}
+
+static void ReleaseArrowArray(ArrowArray* array) {
+  ReleaseArrowNode<ArrowArray, ArrowArrayData>(array);
+}
+
+static void ReleaseArrowSchema(ArrowSchema* schema) {
+  ReleaseArrowNode<ArrowSchema, ArrowSchemaData>(schema);
+}
+
+static const char* ArrowFormat(TF_DataType data_type) {
+  switch (data_type) {
+    case TF_FLOAT:
+      return "f";
+    case TF_DOUBLE:
+      return "g";
+    case TF_HALF:
+      return "e";
+    case TF_INT8:
+      return "c";
+    case TF_UINT8:
+      return "C";
+    case TF_INT16:
+      return "s";
+    case TF_UINT16:
+      return "S";
+    case TF_INT32:
+      return "i";
+    case TF_UINT32:
+      return "I";
+    case TF_INT64:
+      return "l";
+    case TF_UINT64:
+      return "L";
+    case TF_BOOL:
+      return "b";
+    default:
+      return nullptr;
+  }
+}
+
+template <typename Offset>
+void FillArrowBinaryValues(const TF_TString* strings, std::size_t count, std::vector<Offset>& offsets, char* bytes) {
+  offsets.resize(count + 1);
+  offsets[0] = 0;
+  std::size_t position = 0;
+  for (std::size_t i = 0; i < count; ++i) {
+    const auto size = TF_StringGetSize(&strings[i]);
+    if (size != 0) {
+      std::memcpy(bytes + position, TF_StringGetDataPointer(&strings[i]), size);
+    }
+    position += size;
+    offsets[i + 1] = static_cast<Offset>(position);
+  }
+}
+
+static bool ExportArrowBinaryValues(const TF_Tensor* tensor, ArrowArrayData& data, std::int64_t& length, const char*& format) {
+  const auto byte_size = TF_TensorByteSize(tensor);
+  if (byte_size % sizeof(TF_TString) != 0) {
+    return false;
+  }
+
+  const auto count = byte_size / sizeof(TF_TString);
+  const auto strings = static_cast<const TF_TString*>(TF_TensorData(tensor));
+  if (count != 0 && strings == nullptr) {
+    return false;
+  }
+
+  std::size_t total_size = 0;
+  for (std::size_t i = 0; i < count; ++i) {
+    const auto size = TF_StringGetSize(&strings[i]);
+    if (size > static_cast<std::size_t>(std::numeric_limits<std::int64_t>::max()) - total_size) {
+      return false;
+    }
+    total_size += size;
+  }
+
+  data.bytes.reset(new char[total_size == 0 ? 1 : total_size]);
+  if (total_size <= static_cast<std::size_t>(std::numeric_limits<std::int32_t>::max())) {
+    FillArrowBinaryValues(strings, count, data.offsets, data.bytes.get());
+    data.buffers = {nullptr, data.offsets.data(), data.bytes.get()};
+    format = "z"; // Binary, int32 offsets.
+  } else {
+    FillArrowBinaryValues(strings, count, data.large_offsets, data.bytes.get());
+    data.buffers = {nullptr, data.large_offsets.data(), data.bytes.get()};
+    format = "Z"; // Large binary, int64 offsets.
+  }
+
+  length = static_cast<std::int64_t>(count);
+  return true;
+}
+
+static bool ExportArrowBoolValues(const TF_Tensor* tensor, ArrowArrayData& data, std::int64_t& length) {
+  const auto count = TF_TensorByteSize(tensor);
+  const auto values = static_cast<const std::uint8_t*>(TF_TensorData(tensor));
+  if (count != 0 && values == nullptr) {
+    return false;
+  }
+
+  data.bitmap.assign((count + 7) / 8, 0);
+  for (std::size_t i = 0; i < count; ++i) {
+    if (values[i] != 0) {
+      data.bitmap[i / 8] = static_cast<std::uint8_t>(data.bitmap[i / 8] | (1u << (i % 8)));
+    }
+  }
+  data.buffers = {nullptr, data.bitmap.data(), nullptr};
+
+  length = static_cast<std::int64_t>(count);
+  return true;
+}
+
+static bool ExportArrowFixedSizeValues(const TF_Tensor* tensor, ArrowArrayData& data, std::int64_t& length) {
+  const auto element_size = FixedSizeDataTypeByteSize(TF_TensorType(tensor));
+  const auto byte_size = TF_TensorByteSize(tensor);
+  if (element_size == 0 || byte_size % element_size != 0) {
+    return false;
+  }
+
+  const auto values = TF_TensorData(tensor);
+  if (byte_size != 0 && values == nullptr) {
+    return false;
+  }
+
+  data.buffers = {nullptr, values, nullptr};
+
+  length = static_cast<std::int64_t>(byte_size / element_size);
+  return true;
+}
+
+template <std::size_t Width, typename GetString>
+void PackFixedWidthRows(std::size_t count, std::uint8_t* bytes, std::int32_t* lengths, const GetString& get_string) {
+  // Stage each row in a fixed-size buffer so the store into the tensor is a single constant-size copy.
+  std::array<std::uint8_t, Width> row;
+  for (std::size_t i = 0; i < count; ++i) {
+    const auto str = get_string(i);
+    row.fill(0);
+    if (!str.empty()) {
+      std::memcpy(row.data(), str.data(), str.size());
+    }
+    std::memcpy(bytes + i * Width, row.data(), Width);
+    lengths[i] = static_cast<std::int32_t>(str.size());
+  }
+}
+
+template <typename GetString>
+bool CreateFixedWidthStringTensorsImpl(std::size_t num_strings, std::size_t width,
+                                       TF_Tensor** bytes, TF_Tensor** lengths,
+                                       GetString get_string) {
+  if (bytes == nullptr || lengths == nullptr) {
+    return false;
+  }
+  *bytes = nullptr;
+  *lengths = nullptr;
+  if (num_strings > static_cast<std::size_t>(std::numeric_limits<std::int64_t>::max()) ||
+      width > static_cast<std::size_t>(std::numeric_limits<std::int32_t>::max()) ||
+      (width != 0 && num_strings > std::numeric_limits<std::size_t>::max() / width)) {
+    return false;
+  }
+  for (std::size_t i = 0; i < num_strings; ++i) {
+    if (get_string(i).size() > width) {
+      return false;
+    }
+  }
+
+  const std::int64_t bytes_dims[] = {static_cast<std::int64_t>(num_strings), static_cast<std::int64_t>(width)};
+  auto bytes_tensor = CreateEmptyTensor(TF_UINT8, bytes_dims, 2);
+  MAKE_SCOPE_EXIT(delete_bytes){ DeleteTensor(bytes_tensor); };
+  auto lengths_tensor = CreateEmptyTensor(TF_INT32, bytes_dims, 1);
+  MAKE_SCOPE_EXIT(delete_lengths){ DeleteTensor(lengths_tensor); };
+  if (bytes_tensor == nullptr || lengths_tensor == nullptr) {
+    return false;
+  }
+
+  auto bytes_data = static_cast<std::uint8_t*>(TF_TensorData(bytes_tensor));
+  auto lengths_data = static_cast<std::int32_t*>(TF_TensorData(lengths_tensor));
+  if (num_strings != 0 && (lengths_data == nullptr || (width != 0 && bytes_data == nullptr))) {
+    return false;
+  }
+
+  switch (width) {
+    case 8:
+      PackFixedWidthRows<8>(num_strings, bytes_data, lengths_data, get_string);
+      break;
+    case 16:
+      PackFixedWidthRows<16>(num_strings, bytes_data, lengths_data, get_string);
+      break;
+    case 32:
+      PackFixedWidthRows<32>(num_strings, bytes_data, lengths_data, get_string);
+      break;
+    default:
+      for (std::size_t i = 0; i < num_strings; ++i) {
+        const auto str = get_string(i);
+        auto* row = bytes_data + i * width;
+        if (!str.empty()) {
+          std::memcpy(row, str.data(), str.size());
+        }
+        if (str.size() != width) {
+          std::memset(row + str.size(), 0, width - str.size());
+        }
+        lengths_data[i] = static_cast<std::int32_t>(str.size());
+      }
+      break;
+  }
+
+  delete_bytes.dismiss();
+  delete_lengths.dismiss();
+  *bytes = bytes_tensor;
+  *lengths = lengths_tensor;
+  return true;
+}
+
+static TF_Tensor* CreateInt32Tensor(const std::int64_t* dims, std::size_t num_dims, const std::vector<std::int32_t>& values) {
+  return CreateTensor(TF_INT32, dims, num_dims, values.data(), values.size() * sizeof(std::int32_t));
+}
+
+template <typename Sequence>
+bool CreateBucketedStringTensorsImpl(const std::vector<Sequence>& sequences,
+                                     const std::vector<std::size_t>& bucket_boundaries,
+                                     std::size_t max_batch_size,
+                                     std::string_view padding,
+                                     std::vector<StringBucketBatch>& batches) {
+  DeleteStringBucketBatches(batches);
+  if (bucket_boundaries.empty() ||
+      bucket_boundaries.back() > static_cast<std::size_t>(std::numeric_limits<std::int32_t>::max()) ||
+      std::adjacent_find(bucket_boundaries.begin(), bucket_boundaries.end(), std::greater_equal<std::size_t>()) != bucket_boundaries.end()) {
+    return false;
+  }
+
+  std::vector<std::vector<std::size_t>> buckets(bucket_boundaries.size());
+  for (std::size_t i = 0; i < sequences.size(); ++i) {
+    const auto bucket = std::lower_bound(bucket_boundaries.begin(), bucket_boundaries.end(), sequences[i].size());
+    if (bucket == bucket_boundaries.end()) {
+      return false;
+    }
+    buckets[static_cast<std::size_t>(bucket - bucket_boundaries.begin())].push_back(i);
+  }
+
+  MAKE_SCOPE_EXIT(delete_batches){ DeleteStringBucketBatches(batches); };
+  for (const auto& bucket : buckets) {
+    const auto batch_size = max_batch_size == 0 ? bucket.size() : max_batch_size;
+    for (std::size_t begin = 0; begin < bucket.size(); begin += batch_size) {
+      const auto end = std::min(bucket.size(), begin + batch_size);
+
+      StringBucketBatch batch;
+      batch.request_indices.assign(bucket.begin() + static_cast<std::ptrdiff_t>(begin), bucket.begin() + static_cast<std::ptrdiff_t>(end));
+
+      std::size_t max_length = 0;
+      for (const auto index : batch.request_indices) {
+        max_length = std::max(max_length, sequences[index].size());
+      }
+
+      const auto rows = batch.request_indices.size();
+      const std::int64_t dims[] = {static_cast<std::int64_t>(rows), static_cast<std::int64_t>(max_length)};
+      std::vector<std::int32_t> lengths(rows);
+      std::vector<std::int32_t> mask(rows * max_length, 0);
+      for (std::size_t row = 0; row < rows; ++row) {
+        const auto length = sequences[batch.request_indices[row]].size();
+        lengths[row] = static_cast<std::int32_t>(length);
+        std::fill_n(mask.begin() + static_cast<std::ptrdiff_t>(row * max_length), length, 1);
+      }
+
+      batch.tokens = CreateStringTensorImpl(dims, 2, rows * max_length, [&](std::size_t i) -> std::string_view {
+        const auto& sequence = sequences[batch.request_indices[i / max_length]];
+        const auto column = i % max_length;
+        return column < sequence.size() ? std::string_view(sequence[column]) : padding;
+      });
+      batch.lengths = CreateInt32Tensor(dims, 1, lengths);
+      batch.mask = CreateInt32Tensor(dims, 2, mask);
+      batches.push_back(std::move(batch));
+      if (batches.back().tokens == nullptr || batches.back().lengths == nullptr || batches.back().mask == nullptr) {
+        return false;
+      }
+    }
+  }
+
+  delete_batches.dismiss();
+  return true;
 }
 
 static TF_Buffer* ReadBufferFromFile(const char* file) {
@@ -325,53 +921,114 @@ bool IsValidThreadCount(std::int32_t thread_count) {
   return thread_count >= 0;
 }
 
-std::vector<std::uint8_t> CreateGpuMemorySessionConfig(double gpu_memory_fraction) {
-  constexpr std::uint32_t gpu_options_field = 6; // ConfigProto.gpu_options.
-  constexpr std::uint32_t allow_soft_placement_field = 7; // ConfigProto.allow_soft_placement.
-  constexpr std::uint32_t gpu_memory_fraction_field = 1; // GPUOptions.per_process_gpu_memory_fraction.
-  constexpr std::uint32_t gpu_allow_growth_field = 4; // GPUOptions.allow_growth.
-
-  std::array<std::uint8_t, sizeof(double)> percentage_bytes = {};
-  StoreLittleEndianDouble(gpu_memory_fraction, percentage_bytes);
-
-  std::vector<std::uint8_t> gpu_options;
-  gpu_options.reserve(11);
-  AppendProtobufFixed64Field(gpu_memory_fraction_field, percentage_bytes, gpu_options);
-  AppendProtobufBoolField(gpu_allow_growth_field, true, gpu_options);
-
-  std::vector<std::uint8_t> config;
-  config.reserve(gpu_options.size() + 4);
-  AppendProtobufMessageField(gpu_options_field, gpu_options, config);
-  AppendProtobufBoolField(allow_soft_placement_field, true, config);
+std::vector<std::uint8_t> CreateRunOptions(const RunOptions& run_options) {
+  constexpr std::uint32_t trace_level_field = 1; // RunOptions.trace_level.
+  constexpr std::uint32_t timeout_in_ms_field = 2; // RunOptions.timeout_in_ms.
+  constexpr std::uint32_t inter_op_thread_pool_field = 3; // RunOptions.inter_op_thread_pool.
 
-  return config;
+  std::vector<std::uint8_t> options;
+  options.reserve(19);
+  if (run_options.trace_level != TraceLevel::NoTrace) {
+    AppendProtobufInt32Field(trace_level_field, static_cast<std::int32_t>(run_options.trace_level), options);
+  }
+  if (run_options.timeout.count() != 0) {
+    AppendProtobufInt64Field(timeout_in_ms_field, static_cast<std::int64_t>(run_options.timeout.count()), options);
+  }
+  if (run_options.inter_op_thread_pool != 0) {
+    AppendProtobufInt32Field(inter_op_thread_pool_field, run_options.inter_op_thread_pool, options);
+  }
+  return options;
 }
 
-std::vector<std::uint8_t> CreateThreadSessionConfig(std::int32_t intra_op_parallelism_threads,
-                                                    std::int32_t inter_op_parallelism_threads) {
-  constexpr std::uint32_t intra_op_parallelism_threads_field = 2; // ConfigProto.intra_op_parallelism_threads.
-  constexpr std::uint32_t inter_op_parallelism_threads_field = 5; // ConfigProto.inter_op_parallelism_threads.
+bool DecodeNodeStepStats(const std::uint8_t* data, std::size_t size, NodeStepStats& node) {
+  constexpr std::uint32_t node_name_field = 1; // NodeExecStats.node_name.
+  constexpr std::uint32_t all_start_micros_field = 2; // NodeExecStats.all_start_micros, then op_start_rel, op_end_rel, all_end_rel.
+  constexpr std::uint32_t all_end_rel_micros_field = 5; // NodeExecStats.all_end_rel_micros.
+  constexpr std::uint32_t timeline_label_field = 8; // NodeExecStats.timeline_label.
+  constexpr std::uint32_t thread_id_field = 10; // NodeExecStats.thread_id.
+  constexpr std::uint32_t all_start_nanos_field = 13; // NodeExecStats.all_start_nanos, then op_start_rel, op_end_rel, all_end_rel.
+  constexpr std::uint32_t all_end_rel_nanos_field = 16; // NodeExecStats.all_end_rel_nanos.
+
+  // Newer runtimes may fill only the nanosecond fields.
+  std::array<std::int64_t, 4> micros = {};
+  std::array<std::int64_t, 4> nanos = {};
+  const auto end = data + size;
+  ProtobufField field;
+  while (data != end) {
+    if (!ReadProtobufField(data, end, field)) {
+      return false;
+    }
 
-  std::vector<std::uint8_t> config;
-  config.reserve(12);
-  AppendProtobufInt32Field(intra_op_parallelism_threads_field, intra_op_parallelism_threads, config);
-  AppendProtobufInt32Field(inter_op_parallelism_threads_field, inter_op_parallelism_threads, config);
-  return config;
+    const auto value = static_cast<std::int64_t>(field.value);
+    if (field.wire_type == ProtobufWireType::LengthDelimited) {
+      if (field.number == node_name_field) {
+        node.node_name.assign(reinterpret_cast<const char*>(field.data), field.size);
+      } else if (field.number == timeline_label_field) {
+        node.timeline_label.assign(reinterpret_cast<const char*>(field.data), field.size);
+      }
+    } else if (field.wire_type == ProtobufWireType::Varint) {
+      if (field.number >= all_start_micros_field && field.number <= all_end_rel_micros_field) {
+        micros[field.number - all_start_micros_field] = value;
+      } else if (field.number >= all_start_nanos_field && field.number <= all_end_rel_nanos_field) {
+        nanos[field.number - all_start_nanos_field] = value;
+      } else if (field.number == thread_id_field) {
+        node.thread_id = static_cast<std::uint32_t>(field.value);
+      }
+    }
+  }
+
+  for (std::size_t i = 0; i < micros.size(); ++i) {
+    if (micros[i] == 0) {
+      micros[i] = nanos[i] / 1000;
+    }
+  }
+  node.all_start_micros = micros[0];
+  node.op_start_rel_micros = micros[1];
+  node.op_end_rel_micros = micros[2];
+  node.all_end_rel_micros = micros[3];
+  return true;
 }
 
-TF_SessionOptions* CreateConfiguredSessionOptions(const std::vector<std::uint8_t>& config, TF_Status* status) {
-  const bool owns_status = status == nullptr;
-  if (status == nullptr) {
-    status = TF_NewStatus();
+bool DecodeDeviceStepStats(const std::uint8_t* data, std::size_t size, std::vector<NodeStepStats>& nodes) {
+  constexpr std::uint32_t device_field = 1; // DeviceStepStats.device.
+  constexpr std::uint32_t node_stats_field = 2; // DeviceStepStats.node_stats.
+
+  std::string device;
+  const auto first_node = nodes.size();
+  const auto end = data + size;
+  ProtobufField field;
+  while (data != end) {
+    if (!ReadProtobufField(data, end, field)) {
+      return false;
+    }
+    if (field.wire_type != ProtobufWireType::LengthDelimited) {
+      continue;
+    }
+
+    if (field.number == device_field) {
+      device.assign(reinterpret_cast<const char*>(field.data), field.size);
+    } else if (field.number == node_stats_field) {
+      nodes.emplace_back();
+      if (!DecodeNodeStepStats(field.data, field.size, nodes.back())) {
+        return false;
+      }
+    }
   }
-  if (status == nullptr) {
-    return nullptr;
+
+  // The device name may follow the node stats in the encoding.
+  for (auto i = first_node; i < nodes.size(); ++i) {
+    nodes[i].device = device;
   }
-  SCOPE_EXIT{
-    if (owns_status) {
-      TF_DeleteStatus(status);
+  return true;
+}
+
+TF_SessionOptions* CreateConfiguredSessionOptions(const std::vector<std::uint8_t>& config, TF_Status* status) {
+  if (status == nullptr) {
+    status = ThreadLocalStatus();
+    if (status == nullptr) {
+      return nullptr;
     }
-  };
+  }
 
   auto options = TF_NewSessionOptions();
   if (options == nullptr) {
@@ -403,11 +1060,11 @@ TF_Graph* LoadGraph(const char* graph_path, TF_Status* status) {
     return nullptr;
   }
 
-  MAKE_SCOPE_EXIT(delete_status){ TF_DeleteStatus(status); };
   if (status == nullptr) {
-    status = TF_NewStatus();
-  } else {
-    delete_status.dismiss();
+    status = ThreadLocalStatus();
+    if (status == nullptr) {
+      return nullptr;
+    }
   }
 
   auto graph = TF_NewGraph();
@@ -431,17 +1088,32 @@ void DeleteGraph(TF_Graph* graph) {
   }
 }
 
+std::string CpuDeviceName(std::int32_t index) {
+  return "/device:CPU:" + std::to_string(index);
+}
+
+GraphDeviceScope::GraphDeviceScope(TF_Graph* graph, std::string device) : graph_(graph), device_(std::move(device)) {}
+
+TF_OperationDescription* GraphDeviceScope::NewOperation(const char* op_type, const char* oper_name) const {
+  auto desc = TF_NewOperation(graph_, op_type, oper_name);
+  if (desc != nullptr && !device_.empty()) {
+    TF_SetDevice(desc, device_.c_str());
+  }
+
+  return desc;
+}
+
 TF_Session* CreateSession(TF_Graph* graph, TF_SessionOptions* options, TF_Status* status) {
   if (graph == nullptr) {
     SetStatus(status, TF_INVALID_ARGUMENT, "Graph must not be null.");
     return nullptr;
   }
 
-  MAKE_SCOPE_EXIT(delete_status){ TF_DeleteStatus(status); };
   if (status == nullptr) {
-    status = TF_NewStatus();
-  } else {
-    delete_status.dismiss();
+    status = ThreadLocalStatus();
+    if (status == nullptr) {
+      return nullptr;
+    }
   }
 
   MAKE_SCOPE_EXIT(delete_options){ DeleteSessionOptions(options); };
@@ -469,11 +1141,11 @@ TF_Code DeleteSession(TF_Session* session, TF_Status* status) {
     return InvalidArgument(status, "Session must not be null.");
   }
 
-  MAKE_SCOPE_EXIT(delete_status){ TF_DeleteStatus(status); };
   if (status == nullptr) {
-    status = TF_NewStatus();
-  } else {
-    delete_status.dismiss();
+    status = ThreadLocalStatus();
+    if (status == nullptr) {
+      return TF_RESOURCE_EXHAUSTED;
+    }
   }
 
   TF_CloseSession(session, status);
@@ -540,6 +1212,148 @@ TF_Code RestoreCheckpoint(TF_Session* session,
   return RestoreCheckpoint(session, graph, checkpoint_prefix, "save/Const", "save/restore_all", status);
 }
 
+namespace {
+
+struct RegisteredRunHooks {
+  std::uint64_t id = 0;
+  RunHook before;
+  RunHook after;
+};
+
+using RunHookList = std::vector<RegisteredRunHooks>;
+
+std::atomic<bool> run_hooks_registered{false};
+std::mutex run_hooks_mutex; // Serializes writers of run_hooks and guards next_run_hook_id.
+std::uint64_t next_run_hook_id = 1;
+
+// Replaced on every change, so a run keeps the list it started with. Runs read it without taking
+// run_hooks_mutex. The free atomic shared_ptr functions are deprecated in C++20, so use std::atomic there.
+#if defined(__cpp_lib_atomic_shared_ptr)
+std::atomic<std::shared_ptr<const RunHookList>> run_hooks;
+
+std::shared_ptr<const RunHookList> LoadRunHooks() {
+  return run_hooks.load(std::memory_order_acquire);
+}
+
+void StoreRunHooks(std::shared_ptr<const RunHookList> hooks) {
+  run_hooks.store(std::move(hooks), std::memory_order_release);
+}
+#else
+std::shared_ptr<const RunHookList> run_hooks;
+
+std::shared_ptr<const RunHookList> LoadRunHooks() {
+  return std::atomic_load_explicit(&run_hooks, std::memory_order_acquire);
+}
+
+void StoreRunHooks(std::shared_ptr<const RunHookList> hooks) {
+  std::atomic_store_explicit(&run_hooks, std::move(hooks), std::memory_order_release);
+}
+#endif
+
+} // namespace
+
+std::uint64_t AddRunHooks(RunHook before, RunHook after) {
+  std::lock_guard<std::mutex> lock(run_hooks_mutex);
+  const auto current = LoadRunHooks();
+  auto hooks = current == nullptr ? std::make_shared<RunHookList>() : std::make_shared<RunHookList>(*current);
+  const auto id = next_run_hook_id++;
+  hooks->push_back({id, std::move(before), std::move(after)});
+  StoreRunHooks(std::move(hooks));
+  run_hooks_registered.store(true, std::memory_order_release);
+  return id;
+}
+
+bool RemoveRunHooks(std::uint64_t id) {
+  std::lock_guard<std::mutex> lock(run_hooks_mutex);
+  const auto current = LoadRunHooks();
+  if (current == nullptr) {
+    return false;
+  }
+
+  auto hooks = std::make_shared<RunHookList>(*current);
+  const auto it = std::find_if(hooks->begin(), hooks->end(), [id](const RegisteredRunHooks& hook) { return hook.id == id; });
+  if (it == hooks->end()) {
+    return false;
+  }
+
+  hooks->erase(it);
+  run_hooks_registered.store(!hooks->empty(), std::memory_order_release);
+  StoreRunHooks(hooks->empty() ? nullptr : std::move(hooks));
+  return true;
+}
+
+static void SessionRunWithHooks(TF_Session* session, const TF_Buffer* run_options,
+                                const TF_Output* inputs, TF_Tensor* const* input_tensors, int ninputs,
+                                const TF_Output* outputs, TF_Tensor** output_tensors, int noutputs,
+                                const TF_Operation* const* target_opers, int ntargets,
+                                TF_Buffer* run_metadata, TF_Status* status) {
+  const auto hooks = LoadRunHooks();
+
+  RunHookContext context;
+  context.session = session;
+  context.inputs = inputs;
+  context.input_tensors = input_tensors;
+  context.num_inputs = static_cast<std::size_t>(ninputs);
+  context.outputs = outputs;
+  context.num_outputs = static_cast<std::size_t>(noutputs);
+  context.target_opers = target_opers;
+  context.num_targets = static_cast<std::size_t>(ntargets);
+  if (hooks != nullptr) {
+    for (const auto& hook : *hooks) {
+      if (hook.before) {
+        hook.before(context);
+      }
+    }
+  }
+
+  const auto started = std::chrono::steady_clock::now();
+  TF_SessionRun(session,
+                run_options, // Run options.
+                inputs, input_tensors, ninputs, // Input tensors, input tensor values, number of inputs.
+                outputs, output_tensors, noutputs, // Output tensors, output tensor values, number of outputs.
+                target_opers, ntargets, // Target operations, number of targets.
+                run_metadata, // Run metadata.
+                status // Output status.
+  );
+  context.duration = std::chrono::steady_clock::now() - started;
+
+  context.output_tensors = output_tensors;
+  context.code = TF_GetCode(status);
+  context.message = TF_Message(status);
+  if (hooks != nullptr) {
+    for (auto it = hooks->rbegin(); it != hooks->rend(); ++it) {
+      if (it->after) {
+        it->after(context);
+      }
+    }
+  }
+}
+
+// Every TF_SessionRun in tf_utils goes through here, so registered run hooks see all of them.
+static void SessionRun(TF_Session* session, const TF_Buffer* run_options,
+                       const TF_Output* inputs, TF_Tensor* const* input_tensors, int ninputs,
+                       const TF_Output* outputs, TF_Tensor** output_tensors, int noutputs,
+                       const TF_Operation* const* target_opers, int ntargets,
+                       TF_Buffer* run_metadata, TF_Status* status) {
+  if (run_hooks_registered.load(std::memory_order_relaxed)) {
+    SessionRunWithHooks(session, run_options,
+                        inputs, input_tensors, ninputs,
+                        outputs, output_tensors, noutputs,
+                        target_opers, ntargets,
+                        run_metadata, status);
+    return;
+  }
+
+  TF_SessionRun(session,
+                run_options, // Run options.
+                inputs, input_tensors, ninputs, // Input tensors, input tensor values, number of inputs.
+                outputs, output_tensors, noutputs, // Output tensors, output tensor values, number of outputs.
+                target_opers, ntargets, // Target operations, number of targets.
+                run_metadata, // Run metadata.
+                status // Output status.
+  );
+}
+
 TF_Code RunSession(TF_Session* session,
                    const TF_Output* inputs, TF_Tensor* const* input_tensors, std::size_t ninputs,
                    const TF_Output* outputs, TF_Tensor** output_tensors, std::size_t noutputs,
@@ -551,11 +1365,12 @@ TF_Code RunSession(TF_Session* session,
                     status);
 }
 
-TF_Code RunSession(TF_Session* session,
-                   const TF_Output* inputs, TF_Tensor* const* input_tensors, std::size_t ninputs,
-                   const TF_Output* outputs, TF_Tensor** output_tensors, std::size_t noutputs,
-                   const TF_Operation* const* target_opers, std::size_t ntargets,
-                   TF_Status* status) {
+static TF_Code RunSessionWithOptions(TF_Session* session,
+                                     const TF_Output* inputs, TF_Tensor* const* input_tensors, std::size_t ninputs,
+                                     const TF_Output* outputs, TF_Tensor** output_tensors, std::size_t noutputs,
+                                     const TF_Operation* const* target_opers, std::size_t ntargets,
+                                     const TF_Buffer* run_options, TF_Buffer* run_metadata,
+                                     TF_Status* status) {
   if (session == nullptr) {
     return InvalidArgument(status, "Session must not be null.");
   }
@@ -580,26 +1395,35 @@ TF_Code RunSession(TF_Session* session,
     return InvalidArgument(status, "Input, output, and target counts must fit TensorFlow C API int parameters.");
   }
 
-  MAKE_SCOPE_EXIT(delete_status){ TF_DeleteStatus(status); };
   if (status == nullptr) {
-    status = TF_NewStatus();
-  } else {
-    delete_status.dismiss();
+    status = ThreadLocalStatus();
+    if (status == nullptr) {
+      return TF_RESOURCE_EXHAUSTED;
+    }
   }
 
-
-  TF_SessionRun(session,
-                nullptr, // Run options.
-                inputs, input_tensors, static_cast<int>(ninputs), // Input tensors, input tensor values, number of inputs.
-                outputs, output_tensors, static_cast<int>(noutputs), // Output tensors, output tensor values, number of outputs.
-                target_opers, static_cast<int>(ntargets), // Target operations, number of targets.
-                nullptr, // Run metadata.
-                status // Output status.
-  );
+  SessionRun(session, run_options,
+             inputs, input_tensors, static_cast<int>(ninputs),
+             outputs, output_tensors, static_cast<int>(noutputs),
+             target_opers, static_cast<int>(ntargets),
+             run_metadata, status);
 
   return TF_GetCode(status);
 }
 
+TF_Code RunSession(TF_Session* session,
+                   const TF_Output* inputs, TF_Tensor* const* input_tensors, std::size_t ninputs,
+                   const TF_Output* outputs, TF_Tensor** output_tensors, std::size_t noutputs,
+                   const TF_Operation* const* target_opers, std::size_t ntargets,
+                   TF_Status* status) {
+  return RunSessionWithOptions(session,
+                               inputs, input_tensors, ninputs,
+                               outputs, output_tensors, noutputs,
+                               target_opers, ntargets,
+                               nullptr, nullptr,
+                               status);
+}
+
 TF_Code RunSession(TF_Session* session,
                    const std::vector<TF_Output>& inputs, const std::vector<TF_Tensor*>& input_tensors,
                    const std::vector<TF_Output>& outputs, std::vector<TF_Tensor*>& output_tensors,
@@ -630,6 +1454,106 @@ TF_Code RunSession(TF_Session* session,
                     status);
 }
 
+static TF_Code RunSessionWithRunOptions(TF_Session* session,
+                                        const std::vector<TF_Output>& inputs, const std::vector<TF_Tensor*>& input_tensors,
+                                        const std::vector<TF_Output>& outputs, std::vector<TF_Tensor*>& output_tensors,
+                                        const RunOptions& options, TF_Buffer* run_metadata,
+                                        TF_Status* status) {
+  if (inputs.size() != input_tensors.size() || outputs.size() != output_tensors.size()) {
+    return InvalidArgument(status, "Input and output tensor counts must match operation counts.");
+  }
+  if (options.timeout.count() < 0 || options.inter_op_thread_pool < -1) {
+    return InvalidArgument(status, "Run timeout must be non-negative and the inter-op thread pool index at least -1.");
+  }
+
+  const auto encoded_options = CreateRunOptions(options);
+  const TF_Buffer run_options = {encoded_options.data(), encoded_options.size(), nullptr};
+
+  return RunSessionWithOptions(session,
+                               inputs.data(), input_tensors.data(), input_tensors.size(),
+                               outputs.data(), output_tensors.data(), output_tensors.size(),
+                               nullptr, 0,
+                               &run_options, run_metadata,
+                               status);
+}
+
+TF_Code RunSession(TF_Session* session,
+                   const std::vector<TF_Output>& inputs, const std::vector<TF_Tensor*>& input_tensors,
+                   const std::vector<TF_Output>& outputs, std::vector<TF_Tensor*>& output_tensors,
+                   const RunOptions& options,
+                   TF_Status* status) {
+  return RunSessionWithRunOptions(session, inputs, input_tensors, outputs, output_tensors, options, nullptr, status);
+}
+
+TF_Code RunSession(TF_Session* session,
+                   const std::vector<TF_Output>& inputs, const std::vector<TF_Tensor*>& input_tensors,
+                   const std::vector<TF_Output>& outputs, std::vector<TF_Tensor*>& output_tensors,
+                   TraceLevel trace_level, std::vector<std::uint8_t>& run_metadata,
+                   TF_Status* status) {
+  auto metadata = TF_NewBuffer();
+  SCOPE_EXIT{ TF_DeleteBuffer(metadata); };
+
+  RunOptions options;
+  options.trace_level = trace_level;
+  const auto code = RunSessionWithRunOptions(session, inputs, input_tensors, outputs, output_tensors, options, metadata, status);
+  const auto data = static_cast<const std::uint8_t*>(metadata->data);
+  if (code == TF_OK && data != nullptr) {
+    run_metadata.assign(data, data + metadata->length);
+  } else {
+    run_metadata.clear();
+  }
+
+  return code;
+}
+
+TF_Code RunSession(TF_Session* session,
+                   const std::vector<TF_Output>& inputs, const std::vector<TF_Tensor*>& input_tensors,
+                   const std::vector<TF_Output>& outputs, std::vector<TF_Tensor*>& output_tensors,
+                   std::chrono::milliseconds timeout,
+                   TF_Status* status) {
+  if (timeout.count() <= 0) {
+    return InvalidArgument(status, "Run timeout must be positive.");
+  }
+
+  RunOptions options;
+  options.timeout = timeout;
+  return RunSessionWithRunOptions(session, inputs, input_tensors, outputs, output_tensors, options, nullptr, status);
+}
+
+bool DecodeStepStats(const std::vector<std::uint8_t>& run_metadata, std::vector<NodeStepStats>& nodes) {
+  constexpr std::uint32_t step_stats_field = 1; // RunMetadata.step_stats.
+  constexpr std::uint32_t dev_stats_field = 1; // StepStats.dev_stats.
+
+  nodes.clear();
+  auto data = run_metadata.data();
+  const auto end = data + run_metadata.size();
+  ProtobufField field;
+  while (data != end) {
+    if (!ReadProtobufField(data, end, field)) {
+      return false;
+    }
+    if (field.number != step_stats_field || field.wire_type != ProtobufWireType::LengthDelimited) {
+      continue;
+    }
+
+    auto step_stats = field.data;
+    const auto step_stats_end = step_stats + field.size;
+    ProtobufField dev_stats;
+    while (step_stats != step_stats_end) {
+      if (!ReadProtobufField(step_stats, step_stats_end, dev_stats)) {
+        return false;
+      }
+      if (dev_stats.number == dev_stats_field &&
+          dev_stats.wire_type == ProtobufWireType::LengthDelimited &&
+          !DecodeDeviceStepStats(dev_stats.data, dev_stats.size, nodes)) {
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
 TF_Tensor* CreateStringTensor(const std::int64_t* dims, std::size_t num_dims,
                               const std::string_view* strings, std::size_t num_strings) {
   if (strings == nullptr && num_strings != 0) {
@@ -651,6 +1575,31 @@ TF_Tensor* CreateStringTensor(const std::vector<std::int64_t>& dims, const std::
   });
 }
 
+TF_Tensor* CreateStringTensorFromFiles(const std::int64_t* dims, std::size_t num_dims,
+                                       const char* const* paths, std::size_t num_paths) {
+  if (paths == nullptr && num_paths != 0) {
+    return nullptr;
+  }
+
+  return CreateStringTensorFromFilesImpl(dims, num_dims, num_paths, [paths](std::size_t i) {
+    return paths[i];
+  });
+}
+
+TF_Tensor* CreateStringTensorFromFiles(const std::vector<std::int64_t>& dims, const std::vector<std::string>& paths) {
+  return CreateStringTensorFromFilesImpl(dims.data(), dims.size(), paths.size(), [&paths](std::size_t i) {
+    return paths[i].c_str();
+  });
+}
+
+TF_Tensor* CreateStringTensorFromFiles(const std::vector<std::string>& paths) {
+  const std::int64_t dims[] = {static_cast<std::int64_t>(paths.size())};
+
+  return CreateStringTensorFromFilesImpl(dims, 1, paths.size(), [&paths](std::size_t i) {
+    return paths[i].c_str();
+  });
+}
+
 std::string GetStringTensorElement(const TF_Tensor* tensor, std::size_t index) {
   if (tensor == nullptr || TF_TensorType(tensor) != TF_STRING) {
     return {};
@@ -699,6 +1648,172 @@ std::vector<std::string> GetStringTensorData(const TF_Tensor* tensor) {
   return result;
 }
 
+bool CreateBucketedStringTensors(const std::vector<std::vector<std::string>>& sequences,
+                                 const std::vector<std::size_t>& bucket_boundaries,
+                                 std::vector<StringBucketBatch>& batches,
+                                 std::size_t max_batch_size,
+                                 std::string_view padding) {
+  return CreateBucketedStringTensorsImpl(sequences, bucket_boundaries, max_batch_size, padding, batches);
+}
+
+bool CreateBucketedStringTensors(const std::vector<std::vector<std::string_view>>& sequences,
+                                 const std::vector<std::size_t>& bucket_boundaries,
+                                 std::vector<StringBucketBatch>& batches,
+                                 std::size_t max_batch_size,
+                                 std::string_view padding) {
+  return CreateBucketedStringTensorsImpl(sequences, bucket_boundaries, max_batch_size, padding, batches);
+}
+
+void DeleteStringBucketBatches(std::vector<StringBucketBatch>& batches) {
+  for (auto& batch : batches) {
+    DeleteTensor(batch.tokens);
+    DeleteTensor(batch.lengths);
+    DeleteTensor(batch.mask);
+  }
+  batches.clear();
+}
+
+bool CreateFixedWidthStringTensors(const std::string_view* strings, std::size_t num_strings, std::size_t width,
+                                   TF_Tensor** bytes, TF_Tensor** lengths) {
+  if (strings == nullptr && num_strings != 0) {
+    return false;
+  }
+
+  return CreateFixedWidthStringTensorsImpl(num_strings, width, bytes, lengths, [strings](std::size_t i) {
+    return strings[i];
+  });
+}
+
+bool CreateFixedWidthStringTensors(const std::vector<std::string_view>& strings, std::size_t width,
+                                   TF_Tensor** bytes, TF_Tensor** lengths) {
+  return CreateFixedWidthStringTensors(strings.data(), strings.size(), width, bytes, lengths);
+}
+
+bool CreateFixedWidthStringTensors(const std::vector<std::string>& strings, std::size_t width,
+                                   TF_Tensor** bytes, TF_Tensor** lengths) {
+  return CreateFixedWidthStringTensorsImpl(strings.size(), width, bytes, lengths, [&strings](std::size_t i) -> std::string_view {
+    return strings[i];
+  });
+}
+
+std::vector<std::string> GetFixedWidthStringTensorData(const TF_Tensor* bytes, const TF_Tensor* lengths) {
+  if (bytes == nullptr || lengths == nullptr ||
+      TF_TensorType(bytes) != TF_UINT8 || TF_TensorType(lengths) != TF_INT32 ||
+      TF_NumDims(bytes) != 2 || TF_NumDims(lengths) != 1 ||
+      TF_Dim(bytes, 0) != TF_Dim(lengths, 0)) {
+    return {};
+  }
+
+  const auto count = static_cast<std::size_t>(TF_Dim(bytes, 0));
+  const auto width = static_cast<std::size_t>(TF_Dim(bytes, 1));
+  const auto bytes_data = static_cast<const char*>(TF_TensorData(bytes));
+  const auto lengths_data = static_cast<const std::int32_t*>(TF_TensorData(lengths));
+  if (count == 0 || lengths_data == nullptr || (width != 0 && bytes_data == nullptr)) {
+    return {};
+  }
+
+  std::vector<std::string> result;
+  result.reserve(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    const auto length = lengths_data[i];
+    if (length < 0 || static_cast<std::size_t>(length) > width) {
+      return {};
+    }
+    result.emplace_back(bytes_data + i * width, static_cast<std::size_t>(length));
+  }
+
+  return result;
+}
+
+bool ExportTensorToArrow(TF_Tensor* tensor, ArrowArray* array, ArrowSchema* schema) {
+  if (tensor == nullptr || array == nullptr) {
+    return false;
+  }
+
+  const auto data_type = TF_TensorType(tensor);
+  auto data = std::make_unique<ArrowArrayData>();
+  std::int64_t length = 0;
+  const char* format = ArrowFormat(data_type);
+  bool copied = true;
+  if (data_type == TF_STRING) {
+    if (!ExportArrowBinaryValues(tensor, *data, length, format)) {
+      return false;
+    }
+  } else if (data_type == TF_BOOL) {
+    if (!ExportArrowBoolValues(tensor, *data, length)) {
+      return false;
+    }
+  } else {
+    if (format == nullptr || !ExportArrowFixedSizeValues(tensor, *data, length)) {
+      return false;
+    }
+    copied = false;
+  }
+
+  std::vector<std::int64_t> dims(static_cast<std::size_t>(TF_NumDims(tensor)));
+  for (std::size_t i = 0; i < dims.size(); ++i) {
+    dims[i] = TF_Dim(tensor, static_cast<int>(i));
+  }
+  // Level k < num_lists is a fixed_size_list of dims[k + 1] entries; level num_lists holds the values.
+  const auto num_lists = dims.size() > 1 ? dims.size() - 1 : 0;
+  auto schema_data = std::make_shared<ArrowSchemaData>();
+  schema_data->children.resize(num_lists);
+  data->children.resize(num_lists);
+  for (std::size_t level = 0; level < num_lists; ++level) {
+    schema_data->formats.push_back("+w:" + std::to_string(dims[level + 1]));
+    schema_data->child_links.push_back(&schema_data->children[level]);
+    data->child_links.push_back(&data->children[level]);
+  }
+
+  if (copied) {
+    DeleteTensor(tensor);
+  } else {
+    data->tensor = tensor;
+  }
+
+  std::shared_ptr<ArrowArrayData> shared_data = std::move(data);
+  std::int64_t level_length = 1;
+  for (std::size_t level = 0; level <= num_lists; ++level) {
+    auto& node = level == 0 ? *array : shared_data->children[level - 1];
+    node.null_count = 0;
+    node.offset = 0;
+    node.dictionary = nullptr;
+    node.release = &ReleaseArrowArray;
+    node.private_data = new std::shared_ptr<ArrowArrayData>(shared_data);
+    if (level < num_lists) {
+      level_length *= dims[level];
+      node.length = level_length;
+      node.n_buffers = 1;
+      node.buffers = shared_data->list_buffers.data();
+      node.n_children = 1;
+      node.children = &shared_data->child_links[level];
+    } else {
+      node.length = length;
+      node.n_buffers = data_type == TF_STRING ? 3 : 2;
+      node.buffers = shared_data->buffers.data();
+      node.n_children = 0;
+      node.children = nullptr;
+    }
+  }
+
+  if (schema != nullptr) {
+    for (std::size_t level = 0; level <= num_lists; ++level) {
+      auto& node = level == 0 ? *schema : schema_data->children[level - 1];
+      node.format = level < num_lists ? schema_data->formats[level].c_str() : format;
+      node.name = level == 0 ? nullptr : "item";
+      node.metadata = nullptr;
+      node.flags = 0;
+      node.n_children = level < num_lists ? 1 : 0;
+      node.children = level < num_lists ? &schema_data->child_links[level] : nullptr;
+      node.dictionary = nullptr;
+      node.release = &ReleaseArrowSchema;
+      node.private_data = new std::shared_ptr<ArrowSchemaData>(schema_data);
+    }
+  }
+
+  return true;
+}
+
 TF_Tensor* CreateEmptyTensor(TF_DataType data_type, const std::int64_t* dims, std::size_t num_dims, std::size_t len) {
   if ((dims == nullptr && num_dims != 0) || !FitsTensorFlowIntParameter(num_dims)) {
     return nullptr;
@@ -789,8 +1904,10 @@ std::vector<std::int64_t> GetTensorShape(TF_Graph* graph, const TF_Output& outpu
     return {};
   }
 
-  auto status = TF_NewStatus();
-  SCOPE_EXIT{ TF_DeleteStatus(status); };
+  auto status = ThreadLocalStatus();
+  if (status == nullptr) {
+    return {};
+  }
 
   auto num_dims = TF_GraphGetTensorNumDims(graph, output, status);
   if (TF_GetCode(status) != TF_OK || num_dims < 0) {
@@ -817,30 +1934,1789 @@ std::vector<std::vector<std::int64_t>> GetTensorsShape(TF_Graph* graph, const st
   return result;
 }
 
-TF_SessionOptions* CreateSessionOptions(double gpu_memory_fraction, TF_Status* status) {
-  // See https://github.com/Neargye/hello_tf_c_api/issues/21 for details.
-  if (!IsValidGpuMemoryFraction(gpu_memory_fraction)) {
-    SetStatus(status, TF_INVALID_ARGUMENT, "gpu_memory_fraction must be finite and in the range [0.0, 1.0].");
-    return nullptr;
+// Unlike GetTensorShape, fails for an input whose rank is unknown or whose lookup failed instead of returning the
+// empty, scalar, shape.
+static bool WarmupInputShape(TF_Graph* graph, const TF_Output& input, std::vector<std::int64_t>& dims) {
+  auto status = ThreadLocalStatus();
+  if (status == nullptr || input.oper == nullptr) {
+    return false;
+  }
+
+  const auto num_dims = TF_GraphGetTensorNumDims(graph, input, status);
+  if (TF_GetCode(status) != TF_OK || num_dims < 0) {
+    return false;
   }
 
-  return CreateConfiguredSessionOptions(CreateGpuMemorySessionConfig(gpu_memory_fraction), status);
+  dims.resize(static_cast<std::size_t>(num_dims));
+  TF_GraphGetTensorShape(graph, input, dims.data(), num_dims, status);
+  return TF_GetCode(status) == TF_OK;
 }
 
-TF_SessionOptions* CreateSessionOptions(std::int32_t intra_op_parallelism_threads, std::int32_t inter_op_parallelism_threads, TF_Status* status) {
-  // See https://github.com/tensorflow/tensorflow/issues/13853 for details.
-  if (!IsValidThreadCount(intra_op_parallelism_threads) || !IsValidThreadCount(inter_op_parallelism_threads)) {
-    SetStatus(status, TF_INVALID_ARGUMENT, "Thread counts must be non-negative.");
+static TF_Tensor* CreateWarmupTensor(TF_DataType data_type, const std::vector<std::int64_t>& dims, WarmupFill fill, std::mt19937& random) {
+  if (data_type == TF_STRING) {
+    std::size_t count = 0;
+    if (!ShapeElementCount(dims.data(), dims.size(), count)) {
+      return nullptr;
+    }
+    return CreateStringTensor(dims, std::vector<std::string_view>(count));
+  }
+
+  auto tensor = CreateEmptyTensor(data_type, dims);
+  if (tensor == nullptr) {
     return nullptr;
   }
 
-  return CreateConfiguredSessionOptions(CreateThreadSessionConfig(intra_op_parallelism_threads, inter_op_parallelism_threads), status);
+  const auto data = TF_TensorData(tensor);
+  const auto byte_size = TF_TensorByteSize(tensor);
+  if (data == nullptr || byte_size == 0) {
+    return tensor;
+  }
+
+  std::memset(data, 0, byte_size);
+  // Only floating-point inputs are randomized; integer inputs are often indices or ids that must stay in range.
+  if (fill == WarmupFill::Random && data_type == TF_FLOAT) {
+    std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+    auto values = static_cast<float*>(data);
+    for (std::size_t i = 0; i < byte_size / sizeof(float); ++i) {
+      values[i] = distribution(random);
+    }
+  } else if (fill == WarmupFill::Random && data_type == TF_DOUBLE) {
+    std::uniform_real_distribution<double> distribution(0.0, 1.0);
+    auto values = static_cast<double*>(data);
+    for (std::size_t i = 0; i < byte_size / sizeof(double); ++i) {
+      values[i] = distribution(random);
+    }
+  }
+
+  return tensor;
 }
 
-void DeleteSessionOptions(TF_SessionOptions* options) {
-  if (options != nullptr) {
-    TF_DeleteSessionOptions(options);
+TF_Code WarmupSession(TF_Session* session, TF_Graph* graph,
+                      const std::vector<TF_Output>& inputs, const std::vector<TF_Output>& outputs,
+                      const std::vector<std::int64_t>& batch_sizes, std::size_t iterations,
+                      std::vector<WarmupPass>& passes,
+                      WarmupFill fill,
+                      TF_Status* status) {
+  passes.clear();
+  if (session == nullptr || graph == nullptr) {
+    return InvalidArgument(status, "Session and graph must not be null.");
+  }
+  if (batch_sizes.empty() || iterations == 0) {
+    return InvalidArgument(status, "Warmup needs at least one batch size and one iteration.");
+  }
+  if (std::any_of(batch_sizes.begin(), batch_sizes.end(), [](std::int64_t batch_size) { return batch_size <= 0; })) {
+    return InvalidArgument(status, "Warmup batch sizes must be positive.");
+  }
+
+  std::vector<std::vector<std::int64_t>> shapes(inputs.size());
+  for (std::size_t i = 0; i < inputs.size(); ++i) {
+    if (!WarmupInputShape(graph, inputs[i], shapes[i])) {
+      return InvalidArgument(status, ("Warmup needs a known rank for every input; input " + std::to_string(i) + " has none.").c_str());
+    }
   }
+
+  std::mt19937 random(0);
+  passes.reserve(batch_sizes.size() * iterations);
+  std::vector<TF_Tensor*> input_tensors;
+  std::vector<TF_Tensor*> output_tensors;
+  SCOPE_EXIT{
+    DeleteTensors(input_tensors);
+    DeleteTensors(output_tensors);
+  };
+
+  for (const auto batch_size : batch_sizes) {
+    DeleteTensors(input_tensors);
+    input_tensors.assign(inputs.size(), nullptr);
+    for (std::size_t i = 0; i < inputs.size(); ++i) {
+      auto dims = shapes[i];
+      std::replace(dims.begin(), dims.end(), std::int64_t{-1}, batch_size);
+      input_tensors[i] = CreateWarmupTensor(TF_OperationOutputType(inputs[i]), dims, fill, random);
+      if (input_tensors[i] == nullptr) {
+        return InvalidArgument(status, "Failed to create a warmup tensor for an input of unsupported type or shape.");
+      }
+    }
+
+    for (std::size_t iteration = 0; iteration < iterations; ++iteration) {
+      output_tensors.assign(outputs.size(), nullptr);
+      const auto start = std::chrono::steady_clock::now();
+      const auto code = RunSession(session, inputs, input_tensors, outputs, output_tensors, status);
+      passes.push_back({batch_size, iteration, std::chrono::steady_clock::now() - start, code});
+      DeleteTensors(output_tensors);
+      output_tensors.clear();
+      if (code != TF_OK) {
+        return code;
+      }
+    }
+  }
+
+  return TF_OK;
+}
+
+SessionConfigBuilder& SessionConfigBuilder::SetDeviceCount(std::string device_type, std::int32_t count) {
+  device_count_[std::move(device_type)] = count;
+  return *this;
+}
+
+SessionConfigBuilder& SessionConfigBuilder::SetIntraOpParallelismThreads(std::int32_t threads) {
+  intra_op_parallelism_threads_ = threads;
+  return *this;
+}
+
+SessionConfigBuilder& SessionConfigBuilder::SetInterOpParallelismThreads(std::int32_t threads) {
+  inter_op_parallelism_threads_ = threads;
+  return *this;
+}
+
+SessionConfigBuilder& SessionConfigBuilder::SetPerProcessGpuMemoryFraction(double gpu_memory_fraction) {
+  per_process_gpu_memory_fraction_ = gpu_memory_fraction;
+  return *this;
+}
+
+SessionConfigBuilder& SessionConfigBuilder::SetGpuAllowGrowth(bool allow_growth) {
+  gpu_allow_growth_ = allow_growth;
+  return *this;
+}
+
+SessionConfigBuilder& SessionConfigBuilder::SetAllowSoftPlacement(bool allow_soft_placement) {
+  allow_soft_placement_ = allow_soft_placement;
+  return *this;
+}
+
+SessionConfigBuilder& SessionConfigBuilder::SetUsePerSessionThreads(bool use_per_session_threads) {
+  use_per_session_threads_ = use_per_session_threads;
+  return *this;
+}
+
+SessionConfigBuilder& SessionConfigBuilder::AddSessionInterOpThreadPool(ThreadPoolOption pool) {
+  session_inter_op_thread_pools_.push_back(std::move(pool));
+  return *this;
+}
+
+SessionConfigBuilder& SessionConfigBuilder::UseSharedInterOpThreadPool(std::string global_name, std::int32_t num_threads) {
+  use_per_session_threads_ = false;
+  session_inter_op_thread_pools_.assign(1, ThreadPoolOption{num_threads, std::move(global_name)});
+  return *this;
+}
+
+SessionConfigBuilder& SessionConfigBuilder::SetIsolateSessionState(bool isolate_session_state) {
+  isolate_session_state_ = isolate_session_state;
+  return *this;
+}
+
+SessionConfigBuilder& SessionConfigBuilder::SetOptimizerLevel(OptimizerLevel level) {
+  optimizer_level_ = level;
+  return *this;
+}
+
+SessionConfigBuilder& SessionConfigBuilder::SetDoCommonSubexpressionElimination(bool enabled) {
+  do_common_subexpression_elimination_ = enabled;
+  return *this;
+}
+
+SessionConfigBuilder& SessionConfigBuilder::SetDoConstantFolding(bool enabled) {
+  do_constant_folding_ = enabled;
+  return *this;
+}
+
+SessionConfigBuilder& SessionConfigBuilder::SetDoFunctionInlining(bool enabled) {
+  do_function_inlining_ = enabled;
+  return *this;
+}
+
+SessionConfigBuilder& SessionConfigBuilder::SetGlobalJitLevel(GlobalJitLevel level) {
+  global_jit_level_ = level;
+  return *this;
+}
+
+SessionConfigBuilder& SessionConfigBuilder::SetCpuGlobalJit(bool enabled) {
+  cpu_global_jit_ = enabled;
+  return *this;
+}
+
+SessionConfigBuilder& SessionConfigBuilder::SetLayoutOptimizer(RewriterToggle toggle) {
+  layout_optimizer_ = toggle;
+  return *this;
+}
+
+SessionConfigBuilder& SessionConfigBuilder::SetConstantFolding(RewriterToggle toggle) {
+  constant_folding_ = toggle;
+  return *this;
+}
+
+SessionConfigBuilder& SessionConfigBuilder::SetArithmeticOptimization(RewriterToggle toggle) {
+  arithmetic_optimization_ = toggle;
+  return *this;
+}
+
+SessionConfigBuilder& SessionConfigBuilder::SetRemapping(RewriterToggle toggle) {
+  remapping_ = toggle;
+  return *this;
+}
+
+SessionConfigBuilder& SessionConfigBuilder::SetAutoMixedPrecisionOnednnBfloat16(RewriterToggle toggle) {
+  auto_mixed_precision_onednn_bfloat16_ = toggle;
+  return *this;
+}
+
+SessionConfigBuilder& SessionConfigBuilder::SetMetaOptimizerIterations(MetaOptimizerIterations iterations) {
+  meta_optimizer_iterations_ = iterations;
+  return *this;
+}
+
+SessionConfigBuilder& SessionConfigBuilder::SetMetaOptimizerTimeout(std::chrono::milliseconds timeout) {
+  meta_optimizer_timeout_ = timeout;
+  return *this;
+}
+
+SessionConfigBuilder& SessionConfigBuilder::SetDisableMetaOptimizer(bool disabled) {
+  disable_meta_optimizer_ = disabled;
+  return *this;
+}
+
+SessionConfigBuilder& SessionConfigBuilder::SetMinGraphNodes(std::int32_t min_graph_nodes) {
+  min_graph_nodes_ = min_graph_nodes;
+  return *this;
+}
+
+TF_Code SessionConfigBuilder::Build(std::vector<std::uint8_t>& config, TF_Status* status) const {
+  constexpr std::uint32_t device_count_field = 1; // ConfigProto.device_count.
+  constexpr std::uint32_t intra_op_parallelism_threads_field = 2; // ConfigProto.intra_op_parallelism_threads.
+  constexpr std::uint32_t inter_op_parallelism_threads_field = 5; // ConfigProto.inter_op_parallelism_threads.
+  constexpr std::uint32_t gpu_options_field = 6; // ConfigProto.gpu_options.
+  constexpr std::uint32_t allow_soft_placement_field = 7; // ConfigProto.allow_soft_placement.
+  constexpr std::uint32_t use_per_session_threads_field = 9; // ConfigProto.use_per_session_threads.
+  constexpr std::uint32_t graph_options_field = 10; // ConfigProto.graph_options.
+  constexpr std::uint32_t session_inter_op_thread_pool_field = 12; // ConfigProto.session_inter_op_thread_pool.
+  constexpr std::uint32_t isolate_session_state_field = 15; // ConfigProto.isolate_session_state.
+  constexpr std::uint32_t map_key_field = 1; // Map entry key.
+  constexpr std::uint32_t map_value_field = 2; // Map entry value.
+  constexpr std::uint32_t gpu_memory_fraction_field = 1; // GPUOptions.per_process_gpu_memory_fraction.
+  constexpr std::uint32_t gpu_allow_growth_field = 4; // GPUOptions.allow_growth.
+  constexpr std::uint32_t optimizer_options_field = 3; // GraphOptions.optimizer_options.
+  constexpr std::uint32_t rewrite_options_field = 10; // GraphOptions.rewrite_options.
+  constexpr std::uint32_t do_common_subexpression_elimination_field = 1; // OptimizerOptions.do_common_subexpression_elimination.
+  constexpr std::uint32_t do_constant_folding_field = 2; // OptimizerOptions.do_constant_folding.
+  constexpr std::uint32_t opt_level_field = 3; // OptimizerOptions.opt_level.
+  constexpr std::uint32_t do_function_inlining_field = 4; // OptimizerOptions.do_function_inlining.
+  constexpr std::uint32_t global_jit_level_field = 5; // OptimizerOptions.global_jit_level.
+  constexpr std::uint32_t cpu_global_jit_field = 7; // OptimizerOptions.cpu_global_jit.
+  constexpr std::uint32_t layout_optimizer_field = 1; // RewriterConfig.layout_optimizer.
+  constexpr std::uint32_t constant_folding_field = 3; // RewriterConfig.constant_folding.
+  constexpr std::uint32_t arithmetic_optimization_field = 7; // RewriterConfig.arithmetic_optimization.
+  constexpr std::uint32_t meta_optimizer_iterations_field = 12; // RewriterConfig.meta_optimizer_iterations.
+  constexpr std::uint32_t remapping_field = 14; // RewriterConfig.remapping.
+  constexpr std::uint32_t min_graph_nodes_field = 17; // RewriterConfig.min_graph_nodes.
+  constexpr std::uint32_t disable_meta_optimizer_field = 19; // RewriterConfig.disable_meta_optimizer.
+  constexpr std::uint32_t meta_optimizer_timeout_ms_field = 20; // RewriterConfig.meta_optimizer_timeout_ms.
+  constexpr std::uint32_t auto_mixed_precision_onednn_bfloat16_field = 31; // RewriterConfig.auto_mixed_precision_onednn_bfloat16.
+  constexpr std::uint32_t num_threads_field = 1; // ThreadPoolOptionProto.num_threads.
+  constexpr std::uint32_t global_name_field = 2; // ThreadPoolOptionProto.global_name.
+
+  // See https://github.com/tensorflow/tensorflow/issues/13853 for details.
+  const auto invalid_thread_count = [](const std::optional<std::int32_t>& threads) {
+    return threads.has_value() && !IsValidThreadCount(*threads);
+  };
+  if (invalid_thread_count(intra_op_parallelism_threads_) || invalid_thread_count(inter_op_parallelism_threads_) ||
+      std::any_of(session_inter_op_thread_pools_.begin(), session_inter_op_thread_pools_.end(),
+                  [](const ThreadPoolOption& pool) { return !IsValidThreadCount(pool.num_threads); })) {
+    return InvalidArgument(status, "Thread counts must be non-negative.");
+  }
+  for (const auto& device : device_count_) {
+    if (device.first.empty() || device.second < 0) {
+      return InvalidArgument(status, "Device counts need a device type and must be non-negative.");
+    }
+  }
+  // See https://github.com/Neargye/hello_tf_c_api/issues/21 for details.
+  if (per_process_gpu_memory_fraction_.has_value() && !IsValidGpuMemoryFraction(*per_process_gpu_memory_fraction_)) {
+    return InvalidArgument(status, "gpu_memory_fraction must be finite and in the range [0.0, 1.0].");
+  }
+
+  config.clear();
+  std::vector<std::uint8_t> message;
+  for (const auto& device : device_count_) {
+    message.clear();
+    AppendProtobufStringField(map_key_field, device.first, message);
+    AppendProtobufInt32Field(map_value_field, device.second, message);
+    AppendProtobufMessageField(device_count_field, message, config);
+  }
+  if (intra_op_parallelism_threads_.has_value()) {
+    AppendProtobufInt32Field(intra_op_parallelism_threads_field, *intra_op_parallelism_threads_, config);
+  }
+  if (inter_op_parallelism_threads_.has_value()) {
+    AppendProtobufInt32Field(inter_op_parallelism_threads_field, *inter_op_parallelism_threads_, config);
+  }
+  if (per_process_gpu_memory_fraction_.has_value() || gpu_allow_growth_.has_value()) {
+    message.clear();
+    if (per_process_gpu_memory_fraction_.has_value()) {
+      std::array<std::uint8_t, sizeof(double)> fraction_bytes = {};
+      StoreLittleEndianDouble(*per_process_gpu_memory_fraction_, fraction_bytes);
+      AppendProtobufFixed64Field(gpu_memory_fraction_field, fraction_bytes, message);
+    }
+    if (gpu_allow_growth_.has_value()) {
+      AppendProtobufBoolField(gpu_allow_growth_field, *gpu_allow_growth_, message);
+    }
+    AppendProtobufMessageField(gpu_options_field, message, config);
+  }
+  if (allow_soft_placement_.has_value()) {
+    AppendProtobufBoolField(allow_soft_placement_field, *allow_soft_placement_, config);
+  }
+  if (use_per_session_threads_.has_value()) {
+    AppendProtobufBoolField(use_per_session_threads_field, *use_per_session_threads_, config);
+  }
+
+  std::vector<std::uint8_t> optimizer_options;
+  if (do_common_subexpression_elimination_.has_value()) {
+    AppendProtobufBoolField(do_common_subexpression_elimination_field, *do_common_subexpression_elimination_, optimizer_options);
+  }
+  if (do_constant_folding_.has_value()) {
+    AppendProtobufBoolField(do_constant_folding_field, *do_constant_folding_, optimizer_options);
+  }
+  if (optimizer_level_.has_value()) {
+    AppendProtobufInt32Field(opt_level_field, static_cast<std::int32_t>(*optimizer_level_), optimizer_options);
+  }
+  if (do_function_inlining_.has_value()) {
+    AppendProtobufBoolField(do_function_inlining_field, *do_function_inlining_, optimizer_options);
+  }
+  if (global_jit_level_.has_value()) {
+    AppendProtobufInt32Field(global_jit_level_field, static_cast<std::int32_t>(*global_jit_level_), optimizer_options);
+  }
+  if (cpu_global_jit_.has_value()) {
+    AppendProtobufBoolField(cpu_global_jit_field, *cpu_global_jit_, optimizer_options);
+  }
+  std::vector<std::uint8_t> rewrite_options;
+  const auto append_toggle = [&rewrite_options](std::uint32_t field, const std::optional<RewriterToggle>& toggle) {
+    if (toggle.has_value()) {
+      AppendProtobufInt32Field(field, static_cast<std::int32_t>(*toggle), rewrite_options);
+    }
+  };
+  append_toggle(layout_optimizer_field, layout_optimizer_);
+  append_toggle(constant_folding_field, constant_folding_);
+  append_toggle(arithmetic_optimization_field, arithmetic_optimization_);
+  if (meta_optimizer_iterations_.has_value()) {
+    AppendProtobufInt32Field(meta_optimizer_iterations_field, static_cast<std::int32_t>(*meta_optimizer_iterations_), rewrite_options);
+  }
+  append_toggle(remapping_field, remapping_);
+  if (min_graph_nodes_.has_value()) {
+    AppendProtobufInt32Field(min_graph_nodes_field, *min_graph_nodes_, rewrite_options);
+  }
+  if (disable_meta_optimizer_.has_value()) {
+    AppendProtobufBoolField(disable_meta_optimizer_field, *disable_meta_optimizer_, rewrite_options);
+  }
+  if (meta_optimizer_timeout_.has_value()) {
+    AppendProtobufInt64Field(meta_optimizer_timeout_ms_field, static_cast<std::int64_t>(meta_optimizer_timeout_->count()), rewrite_options);
+  }
+  append_toggle(auto_mixed_precision_onednn_bfloat16_field, auto_mixed_precision_onednn_bfloat16_);
+  if (!optimizer_options.empty() || !rewrite_options.empty()) {
+    message.clear();
+    if (!optimizer_options.empty()) {
+      AppendProtobufMessageField(optimizer_options_field, optimizer_options, message);
+    }
+    if (!rewrite_options.empty()) {
+      AppendProtobufMessageField(rewrite_options_field, rewrite_options, message);
+    }
+    AppendProtobufMessageField(graph_options_field, message, config);
+  }
+
+  for (const auto& pool : session_inter_op_thread_pools_) {
+    message.clear();
+    AppendProtobufInt32Field(num_threads_field, pool.num_threads, message);
+    if (!pool.global_name.empty()) {
+      AppendProtobufStringField(global_name_field, pool.global_name, message);
+    }
+    AppendProtobufMessageField(session_inter_op_thread_pool_field, message, config);
+  }
+  if (isolate_session_state_.has_value()) {
+    AppendProtobufBoolField(isolate_session_state_field, *isolate_session_state_, config);
+  }
+
+  return TF_OK;
+}
+
+TF_SessionOptions* SessionConfigBuilder::CreateSessionOptions(TF_Status* status) const {
+  std::vector<std::uint8_t> config;
+  if (Build(config, status) != TF_OK) {
+    return nullptr;
+  }
+
+  return CreateConfiguredSessionOptions(config, status);
+}
+
+TF_SessionOptions* CreateSessionOptions(double gpu_memory_fraction, TF_Status* status) {
+  return SessionConfigBuilder()
+      .SetPerProcessGpuMemoryFraction(gpu_memory_fraction)
+      .SetGpuAllowGrowth(true)
+      .SetAllowSoftPlacement(true)
+      .CreateSessionOptions(status);
+}
+
+TF_SessionOptions* CreateSessionOptions(std::int32_t intra_op_parallelism_threads, std::int32_t inter_op_parallelism_threads, TF_Status* status) {
+  return SessionConfigBuilder()
+      .SetIntraOpParallelismThreads(intra_op_parallelism_threads)
+      .SetInterOpParallelismThreads(inter_op_parallelism_threads)
+      .CreateSessionOptions(status);
+}
+
+TF_SessionOptions* CreateSessionOptions(std::int32_t intra_op_parallelism_threads, const std::vector<ThreadPoolOption>& inter_op_thread_pools, TF_Status* status) {
+  if (inter_op_thread_pools.empty()) {
+    SetStatus(status, TF_INVALID_ARGUMENT, "At least one inter-op thread pool is required.");
+    return nullptr;
+  }
+
+  SessionConfigBuilder builder;
+  builder.SetIntraOpParallelismThreads(intra_op_parallelism_threads);
+  for (const auto& pool : inter_op_thread_pools) {
+    builder.AddSessionInterOpThreadPool(pool);
+  }
+  return builder.CreateSessionOptions(status);
+}
+
+void DeleteSessionOptions(TF_SessionOptions* options) {
+  if (options != nullptr) {
+    TF_DeleteSessionOptions(options);
+  }
+}
+
+SharedSessionRunner::SharedSessionRunner(TF_Session* session,
+                                         std::vector<TF_Output> inputs,
+                                         std::vector<TF_Output> outputs,
+                                         std::vector<const TF_Operation*> target_opers)
+    : session_(session),
+      inputs_(std::move(inputs)),
+      outputs_(std::move(outputs)),
+      target_opers_(std::move(target_opers)),
+      valid_(session_ != nullptr &&
+             FitsTensorFlowIntParameter(inputs_.size()) &&
+             FitsTensorFlowIntParameter(outputs_.size()) &&
+             FitsTensorFlowIntParameter(target_opers_.size())) {}
+
+TF_Code SharedSessionRunner::Run(TF_Tensor* const* input_tensors, TF_Tensor** output_tensors, TF_Status* status) const {
+  if (status == nullptr) {
+    status = ThreadLocalStatus();
+    if (status == nullptr) {
+      return TF_RESOURCE_EXHAUSTED;
+    }
+  }
+  if (!valid_) {
+    return InvalidArgument(status, "Shared session runner requires a session and counts that fit TensorFlow C API int parameters.");
+  }
+  if ((!inputs_.empty() && input_tensors == nullptr) || (!outputs_.empty() && output_tensors == nullptr)) {
+    return InvalidArgument(status, "Tensor arrays must not be null when the runner has inputs or outputs.");
+  }
+
+  SessionRun(session_, nullptr,
+             inputs_.data(), input_tensors, static_cast<int>(inputs_.size()),
+             outputs_.data(), output_tensors, static_cast<int>(outputs_.size()),
+             target_opers_.data(), static_cast<int>(target_opers_.size()),
+             nullptr, status);
+
+  return TF_GetCode(status);
+}
+
+TF_Code SharedSessionRunner::Run(const std::vector<TF_Tensor*>& input_tensors, std::vector<TF_Tensor*>& output_tensors, TF_Status* status) const {
+  if (input_tensors.size() != inputs_.size()) {
+    return InvalidArgument(status == nullptr ? ThreadLocalStatus() : status, "Input tensor count must match operation count.");
+  }
+
+  output_tensors.assign(outputs_.size(), nullptr);
+  return Run(input_tensors.data(), output_tensors.data(), status);
+}
+
+// Runs into spare and only then deletes the previous outputs, so a run may feed them back as inputs. The previous
+// outputs are replaced even when the run fails. Both arrays keep their capacity, so steady-state runs do not allocate.
+template <typename RunFn>
+static TF_Code RunRecyclingOutputs(std::vector<TF_Tensor*>& output_tensors, std::vector<TF_Tensor*>& spare,
+                                   std::size_t num_outputs, RunFn run) {
+  spare.assign(num_outputs, nullptr);
+  const auto code = run(spare.data());
+  output_tensors.swap(spare);
+  DeleteTensors(spare);
+  spare.clear();
+
+  return code;
+}
+
+namespace {
+
+struct ScratchOutputs {
+  ScratchOutputs() = default;
+
+  ScratchOutputs(const ScratchOutputs&) = delete;
+
+  ScratchOutputs& operator=(const ScratchOutputs&) = delete;
+
+  ~ScratchOutputs() {
+    DeleteTensors(tensors);
+  }
+
+  std::vector<TF_Tensor*> tensors;
+  std::vector<TF_Tensor*> spare; // The array the running call writes into.
+};
+
+} // namespace
+
+static ScratchOutputs& ThreadLocalScratchOutputs() {
+  thread_local ScratchOutputs scratch;
+
+  return scratch;
+}
+
+TF_Code SharedSessionRunner::Run(const std::vector<TF_Tensor*>& input_tensors, TF_Status* status) const {
+  // Rejected calls keep the previous outputs, which may be among input_tensors.
+  if (input_tensors.size() != inputs_.size() || !valid_) {
+    std::vector<TF_Tensor*> unused;
+    return Run(input_tensors, unused, status);
+  }
+
+  auto& scratch = ThreadLocalScratchOutputs();
+  return RunRecyclingOutputs(scratch.tensors, scratch.spare, outputs_.size(), [&](TF_Tensor** output_tensors) {
+    return Run(input_tensors.data(), output_tensors, status);
+  });
+}
+
+TF_Tensor* SharedSessionRunner::ScratchOutput(std::size_t index) {
+  const auto& output_tensors = ThreadLocalScratchOutputs().tensors;
+  return index < output_tensors.size() ? output_tensors[index] : nullptr;
+}
+
+TF_Tensor* SharedSessionRunner::ReleaseScratchOutput(std::size_t index) {
+  auto& output_tensors = ThreadLocalScratchOutputs().tensors;
+  if (index >= output_tensors.size()) {
+    return nullptr;
+  }
+
+  auto tensor = output_tensors[index];
+  output_tensors[index] = nullptr;
+  return tensor;
+}
+
+const char* SharedSessionRunner::LastMessage() {
+  auto status = ThreadLocalStatus();
+  return status == nullptr ? "" : TF_Message(status);
+}
+
+static bool ResolveOutput(TF_Graph* graph, const std::string& name, TF_Output& output) {
+  auto oper_name = name;
+  int index = 0;
+  const auto colon = name.rfind(':');
+  if (colon != std::string::npos && colon + 1 < name.size() &&
+      name.find_first_not_of("0123456789", colon + 1) == std::string::npos) {
+    const auto suffix = name.substr(colon + 1);
+    if (suffix.size() > 9) {
+      return false;
+    }
+    oper_name = name.substr(0, colon);
+    index = std::stoi(suffix);
+  }
+
+  output.oper = TF_GraphOperationByName(graph, oper_name.c_str());
+  output.index = index;
+
+  return output.oper != nullptr && index < TF_OperationNumOutputs(output.oper);
+}
+
+PreparedRun::~PreparedRun() {
+  DeleteTensors(output_tensors_);
+  if (status_ != nullptr) {
+    TF_DeleteStatus(status_);
+  }
+}
+
+TF_Code PreparedRun::Run(TF_Tensor* const* input_tensors, TF_Status* status) {
+  if (status == nullptr) {
+    status = status_;
+  }
+  if (!inputs_.empty() && input_tensors == nullptr) {
+    return InvalidArgument(status, "Input tensor array must not be null when the run has inputs.");
+  }
+
+  return RunRecyclingOutputs(output_tensors_, spare_output_tensors_, outputs_.size(), [&](TF_Tensor** output_tensors) {
+    SessionRun(session_, nullptr,
+               inputs_.data(), input_tensors, static_cast<int>(inputs_.size()),
+               outputs_.data(), output_tensors, static_cast<int>(outputs_.size()),
+               target_opers_.data(), static_cast<int>(target_opers_.size()),
+               nullptr, status);
+
+    return TF_GetCode(status);
+  });
+}
+
+TF_Code PreparedRun::Run(const std::vector<TF_Tensor*>& input_tensors, TF_Status* status) {
+  if (input_tensors.size() != inputs_.size()) {
+    return InvalidArgument(status == nullptr ? status_ : status, "Input tensor count must match operation count.");
+  }
+
+  return Run(input_tensors.data(), status);
+}
+
+TF_Tensor* PreparedRun::ReleaseOutput(std::size_t index) {
+  if (index >= output_tensors_.size()) {
+    return nullptr;
+  }
+
+  auto tensor = output_tensors_[index];
+  output_tensors_[index] = nullptr;
+  return tensor;
+}
+
+const char* PreparedRun::message() const {
+  return TF_Message(status_);
+}
+
+PreparedRun* CreatePreparedRun(TF_Session* session, TF_Graph* graph,
+                               const std::vector<std::string>& input_names,
+                               const std::vector<std::string>& output_names,
+                               const std::vector<std::string>& target_names,
+                               TF_Status* status) {
+  if (session == nullptr || graph == nullptr) {
+    SetStatus(status, TF_INVALID_ARGUMENT, "Session and graph must not be null.");
+    return nullptr;
+  }
+  if (!FitsTensorFlowIntParameter(input_names.size()) ||
+      !FitsTensorFlowIntParameter(output_names.size()) ||
+      !FitsTensorFlowIntParameter(target_names.size())) {
+    SetStatus(status, TF_INVALID_ARGUMENT, "Input, output, and target counts must fit TensorFlow C API int parameters.");
+    return nullptr;
+  }
+
+  std::unique_ptr<PreparedRun> run(new PreparedRun());
+  run->session_ = session;
+  const auto resolve = [graph, status](const std::vector<std::string>& names, std::vector<TF_Output>& outputs) {
+    outputs.resize(names.size());
+    for (std::size_t i = 0; i < names.size(); ++i) {
+      if (!ResolveOutput(graph, names[i], outputs[i])) {
+        SetStatus(status, TF_INVALID_ARGUMENT, ("Operation output not found in graph: " + names[i]).c_str());
+        return false;
+      }
+    }
+
+    return true;
+  };
+  if (!resolve(input_names, run->inputs_) || !resolve(output_names, run->outputs_)) {
+    return nullptr;
+  }
+  for (const auto& name : target_names) {
+    const auto oper = TF_GraphOperationByName(graph, name.c_str());
+    if (oper == nullptr) {
+      SetStatus(status, TF_INVALID_ARGUMENT, ("Target operation not found in graph: " + name).c_str());
+      return nullptr;
+    }
+    run->target_opers_.push_back(oper);
+  }
+
+  run->output_tensors_.assign(run->outputs_.size(), nullptr);
+  run->spare_output_tensors_.reserve(run->outputs_.size());
+  run->status_ = TF_NewStatus();
+  if (run->status_ == nullptr) {
+    SetStatus(status, TF_RESOURCE_EXHAUSTED, "Failed to allocate TensorFlow status.");
+    return nullptr;
+  }
+
+  return run.release();
+}
+
+void DeletePreparedRun(PreparedRun* run) {
+  delete run;
+}
+
+PartialRun::PartialRun(PartialRun&& other) noexcept
+    : session_(other.session_), handle_(other.handle_) {
+  other.session_ = nullptr;
+  other.handle_ = nullptr;
+}
+
+PartialRun& PartialRun::operator=(PartialRun&& other) noexcept {
+  if (this != &other) {
+    Reset();
+    session_ = other.session_;
+    handle_ = other.handle_;
+    other.session_ = nullptr;
+    other.handle_ = nullptr;
+  }
+
+  return *this;
+}
+
+PartialRun::~PartialRun() {
+  Reset();
+}
+
+void PartialRun::Reset() {
+  if (handle_ != nullptr) {
+    TF_DeletePRunHandle(handle_);
+    handle_ = nullptr;
+  }
+  session_ = nullptr;
+}
+
+TF_Code PartialRun::Run(const std::vector<TF_Output>& inputs, const std::vector<TF_Tensor*>& input_tensors,
+                        const std::vector<TF_Output>& outputs, std::vector<TF_Tensor*>& output_tensors,
+                        TF_Status* status) {
+  return Run(inputs, input_tensors, outputs, output_tensors, {}, status);
+}
+
+TF_Code PartialRun::Run(const std::vector<TF_Output>& inputs, const std::vector<TF_Tensor*>& input_tensors,
+                        const std::vector<TF_Output>& outputs, std::vector<TF_Tensor*>& output_tensors,
+                        const std::vector<const TF_Operation*>& target_opers,
+                        TF_Status* status) {
+  if (handle_ == nullptr) {
+    return InvalidArgument(status, "Partial run has no handle.");
+  }
+  if (inputs.size() != input_tensors.size() || outputs.size() != output_tensors.size()) {
+    return InvalidArgument(status, "Input and output tensor counts must match operation counts.");
+  }
+  if (!FitsTensorFlowIntParameter(inputs.size()) ||
+      !FitsTensorFlowIntParameter(outputs.size()) ||
+      !FitsTensorFlowIntParameter(target_opers.size())) {
+    return InvalidArgument(status, "Input, output, and target counts must fit TensorFlow C API int parameters.");
+  }
+
+  if (status == nullptr) {
+    status = ThreadLocalStatus();
+    if (status == nullptr) {
+      return TF_RESOURCE_EXHAUSTED;
+    }
+  }
+
+  TF_SessionPRun(session_, handle_,
+                 inputs.data(), input_tensors.data(), static_cast<int>(inputs.size()), // Input tensors, input tensor values, number of inputs.
+                 outputs.data(), output_tensors.data(), static_cast<int>(outputs.size()), // Output tensors, output tensor values, number of outputs.
+                 target_opers.data(), static_cast<int>(target_opers.size()), // Target operations, number of targets.
+                 status // Output status.
+  );
+
+  return TF_GetCode(status);
+}
+
+PartialRun SetupPartialRun(TF_Session* session,
+                           const std::vector<TF_Output>& inputs,
+                           const std::vector<TF_Output>& outputs,
+                           const std::vector<const TF_Operation*>& target_opers,
+                           TF_Status* status) {
+  if (session == nullptr) {
+    SetStatus(status, TF_INVALID_ARGUMENT, "Session must not be null.");
+    return {};
+  }
+  if (!FitsTensorFlowIntParameter(inputs.size()) ||
+      !FitsTensorFlowIntParameter(outputs.size()) ||
+      !FitsTensorFlowIntParameter(target_opers.size())) {
+    SetStatus(status, TF_INVALID_ARGUMENT, "Input, output, and target counts must fit TensorFlow C API int parameters.");
+    return {};
+  }
+
+  if (status == nullptr) {
+    status = ThreadLocalStatus();
+    if (status == nullptr) {
+      return {};
+    }
+  }
+
+  const char* handle = nullptr;
+  TF_SessionPRunSetup(session,
+                      inputs.data(), static_cast<int>(inputs.size()), // Input tensors, number of inputs.
+                      outputs.data(), static_cast<int>(outputs.size()), // Output tensors, number of outputs.
+                      target_opers.data(), static_cast<int>(target_opers.size()), // Target operations, number of targets.
+                      &handle, // Output partial run handle.
+                      status // Output status.
+  );
+  if (TF_GetCode(status) != TF_OK) {
+    if (handle != nullptr) {
+      TF_DeletePRunHandle(handle);
+    }
+    return {};
+  }
+
+  return PartialRun(session, handle);
+}
+
+SessionPool::Lease::Lease(Lease&& other) noexcept
+    : pool_(other.pool_), index_(other.index_) {
+  other.pool_ = nullptr;
+}
+
+SessionPool::Lease& SessionPool::Lease::operator=(Lease&& other) noexcept {
+  if (this != &other) {
+    Release();
+    pool_ = other.pool_;
+    index_ = other.index_;
+    other.pool_ = nullptr;
+  }
+
+  return *this;
+}
+
+SessionPool::Lease::~Lease() {
+  Release();
+}
+
+TF_Session* SessionPool::Lease::session() const {
+  return pool_ == nullptr ? nullptr : pool_->slots_[index_].session;
+}
+
+void SessionPool::Lease::Release() {
+  if (pool_ != nullptr) {
+    pool_->Return(index_);
+    pool_ = nullptr;
+  }
+}
+
+SessionPool::SessionPool(std::size_t size)
+    : size_(size), slots_(new Slot[size]), created_at_(std::chrono::steady_clock::now()) {}
+
+SessionPool::~SessionPool() {
+  for (std::size_t i = 0; i < size_; ++i) {
+    if (slots_[i].session != nullptr) {
+      DeleteSession(slots_[i].session);
+    }
+  }
+}
+
+bool SessionPool::Pop(std::size_t& index) {
+  auto head = head_.load();
+  for (;;) {
+    const auto top = static_cast<std::uint32_t>(head);
+    if (top == 0) {
+      return false;
+    }
+
+    const auto next = slots_[top - 1].next.load(std::memory_order_relaxed);
+    const auto tag = (head >> 32u) + 1u;
+    if (head_.compare_exchange_weak(head, (tag << 32u) | next)) {
+      index = top - 1;
+      return true;
+    }
+  }
+}
+
+void SessionPool::Push(std::size_t index) {
+  auto head = head_.load();
+  for (;;) {
+    slots_[index].next.store(static_cast<std::uint32_t>(head), std::memory_order_relaxed);
+    const auto tag = (head >> 32u) + 1u;
+    if (head_.compare_exchange_weak(head, (tag << 32u) | static_cast<std::uint32_t>(index + 1))) {
+      return;
+    }
+  }
+}
+
+static std::int64_t SteadyClockNanoseconds() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+SessionPool::Lease SessionPool::Checkout(std::size_t index) {
+  auto& slot = slots_[index];
+  slot.checkouts.fetch_add(1, std::memory_order_relaxed);
+  slot.acquired_at_ns.store(SteadyClockNanoseconds(), std::memory_order_relaxed);
+
+  return Lease(this, index);
+}
+
+void SessionPool::Return(std::size_t index) {
+  auto& slot = slots_[index];
+  slot.busy_ns.fetch_add(SteadyClockNanoseconds() - slot.acquired_at_ns.load(std::memory_order_relaxed), std::memory_order_relaxed);
+
+  Push(index);
+  if (waiters_.load() != 0) {
+    std::lock_guard<std::mutex> lock(wait_mutex_);
+    wait_cv_.notify_one();
+  }
+}
+
+SessionPool::Lease SessionPool::TryAcquire() {
+  std::size_t index = 0;
+  if (!Pop(index)) {
+    return {};
+  }
+
+  return Checkout(index);
+}
+
+SessionPool::Lease SessionPool::Acquire() {
+  return Acquire(std::chrono::nanoseconds::max());
+}
+
+SessionPool::Lease SessionPool::Acquire(std::chrono::nanoseconds timeout) {
+  std::size_t index = 0;
+  if (Pop(index)) {
+    return Checkout(index);
+  }
+  if (timeout <= std::chrono::nanoseconds::zero()) {
+    return {};
+  }
+
+  std::unique_lock<std::mutex> lock(wait_mutex_);
+  waiters_.fetch_add(1);
+  SCOPE_EXIT{ waiters_.fetch_sub(1); };
+  const auto ready = [this, &index] {
+    return Pop(index);
+  };
+  if (timeout == std::chrono::nanoseconds::max()) {
+    wait_cv_.wait(lock, ready);
+  } else if (!wait_cv_.wait_for(lock, timeout, ready)) {
+    return {};
+  }
+
+  return Checkout(index);
+}
+
+std::vector<SessionPool::SessionUsage> SessionPool::Usage() const {
+  const auto lifetime = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - created_at_);
+
+  std::vector<SessionUsage> usage(size_);
+  for (std::size_t i = 0; i < size_; ++i) {
+    usage[i].checkouts = slots_[i].checkouts.load(std::memory_order_relaxed);
+    usage[i].busy_time = std::chrono::nanoseconds(slots_[i].busy_ns.load(std::memory_order_relaxed));
+    if (lifetime.count() > 0) {
+      usage[i].utilization = static_cast<double>(usage[i].busy_time.count()) / static_cast<double>(lifetime.count());
+    }
+  }
+
+  return usage;
+}
+
+SessionPool* CreateSessionPool(TF_Graph* graph, std::size_t count, TF_SessionOptions* options, TF_Status* status) {
+  if (graph == nullptr) {
+    SetStatus(status, TF_INVALID_ARGUMENT, "Graph must not be null.");
+    return nullptr;
+  }
+  if (count == 0 || count >= std::numeric_limits<std::uint32_t>::max()) {
+    SetStatus(status, TF_INVALID_ARGUMENT, "Session pool size must be positive and fit 32 bits.");
+    return nullptr;
+  }
+
+  std::unique_ptr<SessionPool> pool(new SessionPool(count));
+  for (std::size_t i = 0; i < count; ++i) {
+    pool->slots_[i].session = CreateSession(graph, options, status);
+    if (pool->slots_[i].session == nullptr) {
+      return nullptr;
+    }
+  }
+  for (std::size_t i = count; i > 0; --i) {
+    pool->Push(i - 1);
+  }
+
+  return pool.release();
+}
+
+void DeleteSessionPool(SessionPool* pool) {
+  delete pool;
+}
+
+SessionExecutor::SessionExecutor(std::size_t queue_capacity)
+    : queue_capacity_(queue_capacity) {}
+
+SessionExecutor::~SessionExecutor() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  cv_.notify_all();
+  for (auto& worker : workers_) {
+    worker.join();
+  }
+}
+
+std::size_t SessionExecutor::queue_depth() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return queue_.size();
+}
+
+bool SessionExecutor::TrySubmit(std::function<void()> task) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stopping_ || queue_.size() >= queue_capacity_) {
+      return false;
+    }
+    queue_.push_back(std::move(task));
+  }
+  cv_.notify_one();
+
+  return true;
+}
+
+void SessionExecutor::Work() {
+  for (;;) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait(lock, [this] {
+        return stopping_ || !queue_.empty();
+      });
+      if (queue_.empty()) {
+        return;
+      }
+      task = std::move(queue_.front());
+      queue_.pop_front();
+    }
+
+    task();
+  }
+}
+
+SessionExecutor* CreateSessionExecutor(std::size_t num_threads, std::size_t queue_capacity, TF_Status* status) {
+  if (num_threads == 0 || queue_capacity == 0) {
+    SetStatus(status, TF_INVALID_ARGUMENT, "Session executor thread count and queue capacity must be positive.");
+    return nullptr;
+  }
+
+  std::unique_ptr<SessionExecutor> executor(new SessionExecutor(queue_capacity));
+  executor->workers_.reserve(num_threads);
+  for (std::size_t i = 0; i < num_threads; ++i) {
+    executor->workers_.emplace_back(&SessionExecutor::Work, executor.get());
+  }
+
+  return executor.release();
+}
+
+void DeleteSessionExecutor(SessionExecutor* executor) {
+  delete executor;
+}
+
+TF_Code RunSessionAsync(SessionExecutor* executor, TF_Session* session,
+                        const std::vector<TF_Output>& inputs, const std::vector<TF_Tensor*>& input_tensors,
+                        const std::vector<TF_Output>& outputs,
+                        std::function<void(RunResult)> done,
+                        TF_Status* status) {
+  if (executor == nullptr) {
+    return InvalidArgument(status, "Session executor must not be null.");
+  }
+  if (session == nullptr) {
+    return InvalidArgument(status, "Session must not be null.");
+  }
+  if (!done) {
+    return InvalidArgument(status, "Completion callback must not be empty.");
+  }
+  if (inputs.size() != input_tensors.size()) {
+    return InvalidArgument(status, "Input tensor count must match operation count.");
+  }
+  if (!FitsTensorFlowIntParameter(inputs.size()) || !FitsTensorFlowIntParameter(outputs.size())) {
+    return InvalidArgument(status, "Input and output counts must fit TensorFlow C API int parameters.");
+  }
+
+  auto task = [session, inputs, input_tensors, outputs, done = std::move(done)] {
+    RunResult result;
+    result.output_tensors.assign(outputs.size(), nullptr);
+
+    auto run_status = ThreadLocalStatus();
+    if (run_status == nullptr) {
+      result.code = TF_RESOURCE_EXHAUSTED;
+      result.message = "Failed to allocate TensorFlow status.";
+    } else {
+      result.code = RunSession(session, inputs, input_tensors, outputs, result.output_tensors, run_status);
+      if (result.code != TF_OK) {
+        result.message = TF_Message(run_status);
+      }
+    }
+    if (result.code != TF_OK) {
+      DeleteTensors(result.output_tensors);
+      result.output_tensors.clear();
+    }
+
+    done(std::move(result));
+  };
+
+  if (!executor->TrySubmit(std::move(task))) {
+    SetStatus(status, TF_RESOURCE_EXHAUSTED, "Session executor queue is full.");
+    return TF_RESOURCE_EXHAUSTED;
+  }
+
+  return TF_OK;
+}
+
+std::future<RunResult> RunSessionAsync(SessionExecutor* executor, TF_Session* session,
+                                       const std::vector<TF_Output>& inputs, const std::vector<TF_Tensor*>& input_tensors,
+                                       const std::vector<TF_Output>& outputs,
+                                       TF_Status* status) {
+  auto promise = std::make_shared<std::promise<RunResult>>();
+  auto future = promise->get_future();
+  const auto code = RunSessionAsync(executor, session, inputs, input_tensors, outputs,
+                                    [promise](RunResult result) {
+                                      promise->set_value(std::move(result));
+                                    },
+                                    status);
+  if (code != TF_OK) {
+    return {};
+  }
+
+  return future;
+}
+
+struct HedgedRunner::State {
+  explicit State(const Options& opts)
+      : options(opts),
+        latencies(std::max<std::size_t>(opts.window, 1)),
+        delay_ns(opts.initial_delay.count()) {}
+
+  void Record(std::chrono::nanoseconds latency) {
+    std::lock_guard<std::mutex> lock(mutex);
+    latencies[next] = latency.count();
+    next = (next + 1) % latencies.size();
+    ++recorded;
+
+    // Recomputed every 1/16 of the window rather than per run, which keeps Record cheap on the worker threads.
+    const auto refresh = std::max<std::size_t>(latencies.size() / 16, 1);
+    if (recorded < std::max<std::size_t>(options.min_samples, 1) || recorded % refresh != 0) {
+      return;
+    }
+
+    const auto count = std::min(recorded, latencies.size());
+    sorted.assign(latencies.begin(), latencies.begin() + static_cast<std::ptrdiff_t>(count));
+    const auto fraction = std::clamp(options.percentile, 0.0, 100.0) / 100.0;
+    const auto rank = static_cast<std::size_t>(std::ceil(fraction * static_cast<double>(count)));
+    const auto nth = sorted.begin() + static_cast<std::ptrdiff_t>(rank == 0 ? 0 : rank - 1);
+    std::nth_element(sorted.begin(), nth, sorted.end());
+    delay_ns.store(*nth, std::memory_order_relaxed);
+  }
+
+  // Reserves one of the max_concurrent_hedges slots.
+  bool ReserveHedge() {
+    auto active = active_hedges.load(std::memory_order_relaxed);
+    while (active < options.max_concurrent_hedges) {
+      if (active_hedges.compare_exchange_weak(active, active + 1, std::memory_order_relaxed)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  Options options;
+  std::mutex mutex; // Guards latencies, next, recorded and sorted.
+  std::vector<std::int64_t> latencies;
+  std::size_t next = 0;
+  std::size_t recorded = 0;
+  std::vector<std::int64_t> sorted;
+  std::atomic<std::int64_t> delay_ns;
+  std::atomic<std::size_t> active_hedges{0};
+  std::atomic<std::uint64_t> runs{0};
+  std::atomic<std::uint64_t> hedges{0};
+  std::atomic<std::uint64_t> hedge_wins{0};
+  std::atomic<std::uint64_t> hedges_skipped{0};
+};
+
+namespace {
+
+// One HedgedRunner::Run call, shared by its primary and hedge runs. It owns the input tensors, so they live until
+// the last run that reads them completes, even when that is after Run returned.
+struct HedgedCall {
+  HedgedCall() = default;
+
+  HedgedCall(const HedgedCall&) = delete;
+
+  HedgedCall& operator=(const HedgedCall&) = delete;
+
+  ~HedgedCall() {
+    DeleteTensors(input_tensors);
+  }
+
+  // The first run to complete wins; a later run only has its outputs deleted.
+  void Complete(RunResult run_result, bool from_hedge) {
+    std::vector<TF_Tensor*> unused;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (done) {
+        unused = std::move(run_result.output_tensors);
+      } else {
+        done = true;
+        hedge_won = from_hedge;
+        result = std::move(run_result);
+      }
+    }
+    DeleteTensors(unused);
+    cv.notify_all();
+  }
+
+  std::vector<TF_Tensor*> input_tensors;
+  std::mutex mutex;
+  std::condition_variable cv;
+  bool done = false;
+  bool hedge_won = false;
+  RunResult result;
+};
+
+} // namespace
+
+HedgedRunner::HedgedRunner(SessionPool* pool, SessionExecutor* executor,
+                           std::vector<TF_Output> inputs, std::vector<TF_Output> outputs,
+                           Options options)
+    : pool_(pool),
+      executor_(executor),
+      inputs_(std::move(inputs)),
+      outputs_(std::move(outputs)),
+      state_(std::make_shared<State>(options)) {}
+
+HedgedRunner::HedgedRunner(SessionPool* pool, SessionExecutor* executor,
+                           std::vector<TF_Output> inputs, std::vector<TF_Output> outputs)
+    : HedgedRunner(pool, executor, std::move(inputs), std::move(outputs), Options{}) {}
+
+TF_Code HedgedRunner::Run(std::vector<TF_Tensor*>&& input_tensors, std::vector<TF_Tensor*>& output_tensors, TF_Status* status) {
+  auto call = std::make_shared<HedgedCall>();
+  call->input_tensors = std::move(input_tensors);
+  input_tensors.clear();
+
+  if (pool_ == nullptr || executor_ == nullptr) {
+    return InvalidArgument(status, "Session pool and executor must not be null.");
+  }
+  if (call->input_tensors.size() != inputs_.size()) {
+    return InvalidArgument(status, "Input tensor count must match operation count.");
+  }
+  if (std::find(call->input_tensors.begin(), call->input_tensors.end(), nullptr) != call->input_tensors.end()) {
+    return InvalidArgument(status, "Input tensors must not be null.");
+  }
+
+  auto state = state_;
+  auto primary = std::make_shared<SessionPool::Lease>(pool_->Acquire());
+  const auto started = std::chrono::steady_clock::now();
+  const auto code = RunSessionAsync(executor_, primary->session(), inputs_, call->input_tensors, outputs_,
+                                    [state, call, primary, started](RunResult result) {
+                                      if (result.code == TF_OK) {
+                                        state->Record(std::chrono::steady_clock::now() - started);
+                                      }
+                                      primary->Release();
+                                      call->Complete(std::move(result), false);
+                                    },
+                                    status);
+  if (code != TF_OK) {
+    return code;
+  }
+  state->runs.fetch_add(1, std::memory_order_relaxed);
+
+  const auto finished = [&call] { return call->done; };
+  const auto delay = hedge_delay();
+  std::unique_lock<std::mutex> lock(call->mutex);
+  if (delay != std::chrono::nanoseconds::max() && !call->cv.wait_for(lock, delay, finished)) {
+    lock.unlock();
+
+    auto hedged = false;
+    if (state->ReserveHedge()) {
+      auto hedge = std::make_shared<SessionPool::Lease>(pool_->TryAcquire());
+      hedged = *hedge &&
+               RunSessionAsync(executor_, hedge->session(), inputs_, call->input_tensors, outputs_,
+                               [state, call, hedge](RunResult result) {
+                                 hedge->Release();
+                                 state->active_hedges.fetch_sub(1, std::memory_order_relaxed);
+                                 call->Complete(std::move(result), true);
+                               }) == TF_OK;
+      if (!hedged) {
+        state->active_hedges.fetch_sub(1, std::memory_order_relaxed);
+      }
+    }
+    (hedged ? state->hedges : state->hedges_skipped).fetch_add(1, std::memory_order_relaxed);
+
+    lock.lock();
+  }
+  call->cv.wait(lock, finished);
+
+  auto result = std::move(call->result);
+  if (call->hedge_won) {
+    state->hedge_wins.fetch_add(1, std::memory_order_relaxed);
+  }
+  lock.unlock();
+
+  if (result.code != TF_OK) {
+    output_tensors.assign(outputs_.size(), nullptr);
+    SetStatus(status, result.code, result.message.c_str());
+    return result.code;
+  }
+
+  output_tensors = std::move(result.output_tensors);
+  SetStatus(status, TF_OK, "");
+  return TF_OK;
+}
+
+std::chrono::nanoseconds HedgedRunner::hedge_delay() const {
+  return std::chrono::nanoseconds{state_->delay_ns.load(std::memory_order_relaxed)};
+}
+
+HedgedRunner::Counters HedgedRunner::counters() const {
+  Counters counters;
+  counters.runs = state_->runs.load(std::memory_order_relaxed);
+  counters.hedges = state_->hedges.load(std::memory_order_relaxed);
+  counters.hedge_wins = state_->hedge_wins.load(std::memory_order_relaxed);
+  counters.hedges_skipped = state_->hedges_skipped.load(std::memory_order_relaxed);
+  return counters;
+}
+
+struct NumaNodeInfo {
+  std::int32_t id = -1;
+  std::vector<std::int32_t> cpus;
+};
+
+// Parses a sysfs list such as "0-3,8,10-11".
+static bool ParseSysfsList(const std::string& text, std::vector<std::int32_t>& values) {
+  values.clear();
+  std::size_t begin = 0;
+  while (begin < text.size() && text[begin] != '\n') {
+    const auto end = std::min(text.find(',', begin), text.size());
+    const auto range = text.substr(begin, end - begin);
+    const auto dash = range.find('-');
+    char* parse_end = nullptr;
+    const auto first = std::strtol(range.c_str(), &parse_end, 10);
+    auto last = first;
+    if (dash != std::string::npos) {
+      last = std::strtol(range.c_str() + dash + 1, &parse_end, 10);
+    }
+    if (parse_end == range.c_str() || first < 0 || last < first || last > std::numeric_limits<std::int32_t>::max()) {
+      return false;
+    }
+    for (auto value = first; value <= last; ++value) {
+      values.push_back(static_cast<std::int32_t>(value));
+    }
+    begin = end + 1;
+  }
+
+  return !values.empty();
+}
+
+// NUMA nodes with at least one CPU the process may run on, or none when there are fewer than two.
+static std::vector<NumaNodeInfo> DiscoverNumaNodes() {
+  std::vector<NumaNodeInfo> nodes;
+#if defined(__linux__)
+  std::ifstream online("/sys/devices/system/node/online");
+  std::string text;
+  std::vector<std::int32_t> node_ids;
+  if (!std::getline(online, text) || !ParseSysfsList(text, node_ids)) {
+    return nodes;
+  }
+
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  if (::sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+    return nodes;
+  }
+
+  std::vector<std::int32_t> cpus;
+  for (const auto id : node_ids) {
+    std::ifstream cpulist("/sys/devices/system/node/node" + std::to_string(id) + "/cpulist");
+    if (!std::getline(cpulist, text) || !ParseSysfsList(text, cpus)) {
+      continue; // Memory-only node.
+    }
+
+    NumaNodeInfo node;
+    node.id = id;
+    for (const auto cpu : cpus) {
+      if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed)) {
+        node.cpus.push_back(cpu);
+      }
+    }
+    if (!node.cpus.empty()) {
+      nodes.push_back(std::move(node));
+    }
+  }
+  if (nodes.size() < 2) {
+    nodes.clear();
+  }
+#endif
+
+  return nodes;
+}
+
+// Restricts the calling thread, and the threads it starts from now on, to cpus. An empty list leaves it unpinned.
+// Fails for CPU ids a cpu_set_t cannot hold, such as sysfs ids on machines with more than CPU_SETSIZE CPUs.
+static bool PinCurrentThread(const std::vector<std::int32_t>& cpus) {
+  if (cpus.empty()) {
+    return true;
+  }
+
+#if defined(__linux__)
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (const auto cpu : cpus) {
+    if (cpu < 0 || cpu >= CPU_SETSIZE) {
+      return false;
+    }
+    CPU_SET(cpu, &set);
+  }
+  return ::sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+  return false;
+#endif
+}
+
+// CPUs the process may run on.
+static std::vector<std::int32_t> AllowedCpus() {
+  std::vector<std::int32_t> cpus;
+#if defined(__linux__)
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  if (::sched_getaffinity(0, sizeof(allowed), &allowed) == 0) {
+    for (std::int32_t cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+      if (CPU_ISSET(cpu, &allowed)) {
+        cpus.push_back(cpu);
+      }
+    }
+    return cpus;
+  }
+#endif
+  for (std::int32_t cpu = 0; cpu < static_cast<std::int32_t>(std::max(1u, std::thread::hardware_concurrency())); ++cpu) {
+    cpus.push_back(cpu);
+  }
+  return cpus;
+}
+
+// TensorFlow's CPU devices share one process-wide intra-op pool, created and sized by the first session in the
+// process and inherited by every later one, unless TF_OVERRIDE_GLOBAL_THREADPOOL is true when TensorFlow creates its
+// first device. With it, every session creates its own intra-op pool on the thread that creates the session.
+static bool SessionsOwnIntraOpPools() {
+  const char* value = std::getenv("TF_OVERRIDE_GLOBAL_THREADPOOL");
+  if (value == nullptr) {
+    return false;
+  }
+
+  std::string text(value);
+  std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+  return text == "1" || text == "true";
+}
+
+// Runs setup on a new thread pinned to cpus and waits for it. Threads that setup starts, such as the pools of a
+// session it creates, inherit the CPU mask.
+static TF_Code RunOnPinnedThread(const std::vector<std::int32_t>& cpus, const std::function<void(TF_Status*)>& setup, TF_Status* status) {
+  TF_Code code = TF_OK;
+  std::string message;
+  std::thread thread([&] {
+    if (!PinCurrentThread(cpus)) {
+      code = TF_INTERNAL;
+      message = "Failed to set the CPU affinity of a thread.";
+      return;
+    }
+
+    auto setup_status = TF_NewStatus();
+    SCOPE_EXIT{ TF_DeleteStatus(setup_status); };
+    setup(setup_status);
+    code = TF_GetCode(setup_status);
+    message = TF_Message(setup_status);
+  });
+  thread.join();
+
+  SetStatus(status, code, message.c_str());
+  return code;
+}
+
+#if defined(__linux__)
+static void UnmapTensorBuffer(void* data, size_t len, void*) {
+  ::munmap(data, len);
+}
+#endif
+
+NumaSessionGroup::NumaSessionGroup(std::size_t num_nodes)
+    : num_nodes_(num_nodes), nodes_(new Node[num_nodes]) {}
+
+NumaSessionGroup::~NumaSessionGroup() {
+  for (std::size_t i = 0; i < num_nodes_; ++i) {
+    DeleteSessionExecutor(nodes_[i].executor);
+    DeleteSession(nodes_[i].session);
+  }
+}
+
+std::int32_t NumaSessionGroup::node_id(std::size_t node) const {
+  return nodes_[node].id;
+}
+
+const std::vector<std::int32_t>& NumaSessionGroup::node_cpus(std::size_t node) const {
+  return nodes_[node].cpus;
+}
+
+TF_Session* NumaSessionGroup::session(std::size_t node) const {
+  return nodes_[node].session;
+}
+
+std::size_t NumaSessionGroup::load(std::size_t node) const {
+  return nodes_[node].load.load(std::memory_order_relaxed);
+}
+
+std::size_t NumaSessionGroup::LeastLoadedNode() const {
+  std::size_t best = 0;
+  auto best_load = load(0);
+  for (std::size_t i = 1; i < num_nodes_ && best_load != 0; ++i) {
+    const auto node_load = load(i);
+    if (node_load < best_load) {
+      best = i;
+      best_load = node_load;
+    }
+  }
+
+  return best;
+}
+
+TF_Tensor* NumaSessionGroup::CreateTensor(std::size_t node, TF_DataType data_type, const std::vector<std::int64_t>& dims, TF_Status* status) const {
+  std::size_t len = 0;
+  if (node >= num_nodes_ || !IsFixedSizeTensorDataType(data_type) || !FitsTensorFlowIntParameter(dims.size()) ||
+      !ExpectedTensorByteSize(data_type, dims.data(), dims.size(), len)) {
+    SetStatus(status, TF_INVALID_ARGUMENT, "NUMA tensors need a valid node index and a fixed-size type and shape.");
+    return nullptr;
+  }
+
+#if defined(__linux__) && defined(SYS_mbind)
+  constexpr int mpol_preferred = 1; // MPOL_PREFERRED; <numaif.h> ships with libnuma, which is not required.
+  constexpr std::size_t max_nodes = 1024;
+  const auto id = nodes_[node].id;
+  if (id >= 0 && static_cast<std::size_t>(id) < max_nodes && len != 0) {
+    auto data = ::mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (data == MAP_FAILED) {
+      SetStatus(status, TF_RESOURCE_EXHAUSTED, "Failed to map the tensor buffer.");
+      return nullptr;
+    }
+
+    // Binding before the first touch places every page on the node as it is faulted in.
+    constexpr std::size_t bits_per_word = sizeof(unsigned long) * 8;
+    std::array<unsigned long, max_nodes / bits_per_word> node_mask = {};
+    node_mask[static_cast<std::size_t>(id) / bits_per_word] = 1UL << (static_cast<std::size_t>(id) % bits_per_word);
+    if (::syscall(SYS_mbind, data, len, mpol_preferred, node_mask.data(), max_nodes + 1, 0) != 0) {
+      ::munmap(data, len);
+      SetStatus(status, TF_INTERNAL, "Failed to bind the tensor buffer to the NUMA node with mbind.");
+      return nullptr;
+    }
+
+    auto tensor = TF_NewTensor(data_type, dims.data(), static_cast<int>(dims.size()), data, len, UnmapTensorBuffer, nullptr);
+    if (tensor == nullptr) {
+      ::munmap(data, len);
+      SetStatus(status, TF_RESOURCE_EXHAUSTED, "Failed to create the tensor.");
+      return nullptr;
+    }
+    SetStatus(status, TF_OK, "");
+    return tensor;
+  }
+#endif
+
+  auto tensor = CreateEmptyTensor(data_type, dims, len);
+  if (tensor == nullptr) {
+    SetStatus(status, TF_RESOURCE_EXHAUSTED, "Failed to create the tensor.");
+    return nullptr;
+  }
+  SetStatus(status, TF_OK, "");
+  return tensor;
+}
+
+TF_Code NumaSessionGroup::RunAsync(std::size_t node,
+                                   const std::vector<TF_Output>& inputs, const std::vector<TF_Tensor*>& input_tensors,
+                                   const std::vector<TF_Output>& outputs,
+                                   std::function<void(RunResult)> done,
+                                   TF_Status* status) {
+  if (node >= num_nodes_) {
+    return InvalidArgument(status, "NUMA node index is out of range.");
+  }
+  if (!done) {
+    return InvalidArgument(status, "Completion callback must not be empty.");
+  }
+
+  auto& load = nodes_[node].load;
+  load.fetch_add(1, std::memory_order_relaxed);
+  const auto code = RunSessionAsync(nodes_[node].executor, nodes_[node].session, inputs, input_tensors, outputs,
+                                    [&load, done = std::move(done)](RunResult result) {
+                                      load.fetch_sub(1, std::memory_order_relaxed);
+                                      done(std::move(result));
+                                    },
+                                    status);
+  if (code != TF_OK) {
+    load.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  return code;
+}
+
+TF_Code NumaSessionGroup::Run(std::size_t node,
+                              const std::vector<TF_Output>& inputs, const std::vector<TF_Tensor*>& input_tensors,
+                              const std::vector<TF_Output>& outputs, std::vector<TF_Tensor*>& output_tensors,
+                              TF_Status* status) {
+  if (outputs.size() != output_tensors.size()) {
+    return InvalidArgument(status, "Input and output tensor counts must match operation counts.");
+  }
+
+  auto promise = std::make_shared<std::promise<RunResult>>();
+  auto future = promise->get_future();
+  const auto code = RunAsync(node, inputs, input_tensors, outputs,
+                             [promise](RunResult result) {
+                               promise->set_value(std::move(result));
+                             },
+                             status);
+  if (code != TF_OK) {
+    return code;
+  }
+
+  auto result = future.get();
+  if (result.code != TF_OK) {
+    SetStatus(status, result.code, result.message.c_str());
+    return result.code;
+  }
+
+  std::copy(result.output_tensors.begin(), result.output_tensors.end(), output_tensors.begin());
+  SetStatus(status, TF_OK, "");
+  return TF_OK;
+}
+
+TF_Code NumaSessionGroup::Run(const std::vector<TF_Output>& inputs, const std::vector<TF_Tensor*>& input_tensors,
+                              const std::vector<TF_Output>& outputs, std::vector<TF_Tensor*>& output_tensors,
+                              TF_Status* status) {
+  return Run(LeastLoadedNode(), inputs, input_tensors, outputs, output_tensors, status);
+}
+
+NumaSessionGroup* CreateNumaSessionGroup(TF_Graph* graph, const SessionConfigBuilder& config,
+                                         std::size_t workers_per_node, std::size_t queue_capacity,
+                                         TF_Status* status) {
+  if (graph == nullptr) {
+    SetStatus(status, TF_INVALID_ARGUMENT, "Graph must not be null.");
+    return nullptr;
+  }
+  if (queue_capacity == 0) {
+    SetStatus(status, TF_INVALID_ARGUMENT, "Session executor thread count and queue capacity must be positive.");
+    return nullptr;
+  }
+
+  auto numa_nodes = DiscoverNumaNodes();
+  if (numa_nodes.empty()) {
+    numa_nodes.emplace_back();
+  } else if (!SessionsOwnIntraOpPools()) {
+    // With the shared pool every node's session would compute on whichever CPUs the first session was pinned to.
+    SetStatus(status, TF_FAILED_PRECONDITION,
+              "NUMA session groups need TF_OVERRIDE_GLOBAL_THREADPOOL=1 set before the process creates its first session.");
+    return nullptr;
+  }
+
+  // The session's inter-op pool (per-session threads) and its intra-op pool (TF_OVERRIDE_GLOBAL_THREADPOOL) are
+  // created by the session's constructor, on the pinned thread below.
+  auto options = SessionConfigBuilder(config).SetUsePerSessionThreads(true).CreateSessionOptions(status);
+  SCOPE_EXIT{ DeleteSessionOptions(options); };
+  if (options == nullptr) {
+    return nullptr;
+  }
+
+  std::unique_ptr<NumaSessionGroup> group(new NumaSessionGroup(numa_nodes.size()));
+  for (std::size_t i = 0; i < numa_nodes.size(); ++i) {
+    auto& node = group->nodes_[i];
+    node.id = numa_nodes[i].id;
+    node.cpus = std::move(numa_nodes[i].cpus);
+    auto workers = workers_per_node;
+    if (workers == 0) {
+      workers = node.cpus.empty() ? std::max(1u, std::thread::hardware_concurrency()) : node.cpus.size();
+    }
+
+    const auto code = RunOnPinnedThread(node.cpus, [&](TF_Status* setup_status) {
+      node.session = CreateSession(graph, options, setup_status);
+      if (node.session != nullptr) {
+        node.executor = CreateSessionExecutor(workers, queue_capacity, setup_status);
+      }
+    }, status);
+    if (code != TF_OK) {
+      return nullptr;
+    }
+  }
+
+  return group.release();
+}
+
+void DeleteNumaSessionGroup(NumaSessionGroup* group) {
+  delete group;
+}
+
+TF_Code PinCurrentThreadToCpus(const std::vector<std::int32_t>& cpus, TF_Status* status) {
+  if (cpus.empty()) {
+    return InvalidArgument(status, "CPU set must not be empty.");
+  }
+#if defined(__linux__)
+  if (!PinCurrentThread(cpus)) {
+    SetStatus(status, TF_INVALID_ARGUMENT, "Failed to set the CPU affinity of the calling thread; CPU indices must be in [0, CPU_SETSIZE).");
+    return TF_INVALID_ARGUMENT;
+  }
+
+  SetStatus(status, TF_OK, "");
+  return TF_OK;
+#else
+  SetStatus(status, TF_UNIMPLEMENTED, "Thread affinity is only supported on Linux.");
+  return TF_UNIMPLEMENTED;
+#endif
+}
+
+CpuPartition PartitionAvailableCpus(std::size_t preprocessing_count, std::size_t session_run_count) {
+  const auto cpus = AllowedCpus();
+  CpuPartition partition;
+  if (preprocessing_count + session_run_count >= cpus.size()) {
+    return partition;
+  }
+
+  const auto preprocessing_end = cpus.begin() + static_cast<std::ptrdiff_t>(preprocessing_count);
+  const auto session_run_end = preprocessing_end + static_cast<std::ptrdiff_t>(session_run_count);
+  partition.preprocessing_cpus.assign(cpus.begin(), preprocessing_end);
+  partition.session_run_cpus.assign(preprocessing_end, session_run_end);
+  partition.tensorflow_cpus.assign(session_run_end, cpus.end());
+  return partition;
+}
+
+TF_Code ValidateCpuPartition(const CpuPartition& partition, TF_Status* status) {
+  if (partition.tensorflow_cpus.empty()) {
+    return InvalidArgument(status, "CPU partition needs at least one TensorFlow CPU.");
+  }
+
+  const auto allowed = AllowedCpus();
+  std::vector<std::int32_t> seen;
+  for (const auto* cpus : {&partition.preprocessing_cpus, &partition.session_run_cpus, &partition.tensorflow_cpus}) {
+    for (const auto cpu : *cpus) {
+      if (std::find(allowed.begin(), allowed.end(), cpu) == allowed.end()) {
+        return InvalidArgument(status, "CPU partition uses a CPU the process may not run on.");
+      }
+      if (std::find(seen.begin(), seen.end(), cpu) != seen.end()) {
+        return InvalidArgument(status, "CPU partition sets must not overlap.");
+      }
+      seen.push_back(cpu);
+    }
+  }
+
+  SetStatus(status, TF_OK, "");
+  return TF_OK;
+}
+
+TF_Session* CreatePartitionedSession(TF_Graph* graph, const CpuPartition& partition, const SessionConfigBuilder& config, TF_Status* status) {
+  if (graph == nullptr) {
+    SetStatus(status, TF_INVALID_ARGUMENT, "Graph must not be null.");
+    return nullptr;
+  }
+  if (ValidateCpuPartition(partition, status) != TF_OK) {
+    return nullptr;
+  }
+  if (!SessionsOwnIntraOpPools()) {
+    // The shared intra-op pool is sized and pinned by whichever session came first, not by this partition.
+    SetStatus(status, TF_FAILED_PRECONDITION,
+              "Partitioned sessions need TF_OVERRIDE_GLOBAL_THREADPOOL=1 set before the process creates its first session.");
+    return nullptr;
+  }
+
+  // One intra-op thread per TensorFlow CPU, and one inter-op thread per concurrent TF_SessionRun caller, so runs do
+  // not queue behind each other for an inter-op thread.
+  const auto tensorflow_threads = partition.tensorflow_cpus.size();
+  const auto inter_op_threads = std::min(std::max<std::size_t>(1, partition.session_run_cpus.size()), tensorflow_threads);
+  auto options = SessionConfigBuilder(config)
+                     .SetIntraOpParallelismThreads(static_cast<std::int32_t>(tensorflow_threads))
+                     .SetInterOpParallelismThreads(static_cast<std::int32_t>(inter_op_threads))
+                     .SetUsePerSessionThreads(true)
+                     .CreateSessionOptions(status);
+  SCOPE_EXIT{ DeleteSessionOptions(options); };
+  if (options == nullptr) {
+    return nullptr;
+  }
+
+  TF_Session* session = nullptr;
+  if (RunOnPinnedThread(partition.tensorflow_cpus, [&](TF_Status* setup_status) {
+        session = CreateSession(graph, options, setup_status);
+      }, status) != TF_OK) {
+    return nullptr;
+  }
+
+  return session;
+}
+
+SessionExecutor* CreatePinnedSessionExecutor(const std::vector<std::int32_t>& cpus, std::size_t num_threads,
+                                             std::size_t queue_capacity, TF_Status* status) {
+  if (cpus.empty()) {
+    SetStatus(status, TF_INVALID_ARGUMENT, "CPU set must not be empty.");
+    return nullptr;
+  }
+
+  // Workers started from the pinned thread inherit its CPU mask.
+  SessionExecutor* executor = nullptr;
+  if (RunOnPinnedThread(cpus, [&](TF_Status* setup_status) {
+        executor = CreateSessionExecutor(num_threads == 0 ? cpus.size() : num_threads, queue_capacity, setup_status);
+      }, status) != TF_OK) {
+    return nullptr;
+  }
+
+  return executor;
 }
 
 const char* DataTypeToString(TF_DataType data_type) {
@@ -28,17 +28,32 @@
 #  endif
 #  pragma warning(push)
 #  pragma warning(disable : 4190)
+#  pragma warning(disable : 4324) // Structure padded due to alignment specifier.
 #endif
 
 #include <tensorflow/c/c_api.h> // TensorFlow C API header.
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cstddef>
 #include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
 #include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
 #include <string_view>
+#include <thread>
 #include <type_traits>
 #include <vector>
 
+struct ArrowArray; // Apache Arrow C data interface, see <arrow/c/abi.h>.
+struct ArrowSchema;
+
 namespace tf_utils {
 
 namespace detail {
@@ -128,6 +143,27 @@ TF_Graph* LoadGraph(const char* graph_path, TF_Status* status = nullptr);
 
 void DeleteGraph(TF_Graph* graph);
 
+// "/device:CPU:<index>" for TF_SetDevice. A session only has CPU devices above 0 when it is created with
+// SessionConfigBuilder::SetDeviceCount("CPU", n), n > index; otherwise the pin fails unless soft placement is on.
+std::string CpuDeviceName(std::int32_t index);
+
+// Builds one subgraph on one device: every operation started through NewOperation is pinned with TF_SetDevice,
+// so independent branches of a wide graph can be given one CPU device each. An empty device leaves placement to
+// TensorFlow.
+class GraphDeviceScope {
+ public:
+  GraphDeviceScope(TF_Graph* graph, std::string device);
+
+  TF_OperationDescription* NewOperation(const char* op_type, const char* oper_name) const;
+
+  TF_Graph* graph() const noexcept { return graph_; }
+  const std::string& device() const noexcept { return device_; }
+
+ private:
+  TF_Graph* graph_;
+  std::string device_;
+};
+
 TF_Session* CreateSession(TF_Graph* graph, TF_SessionOptions* options, TF_Status* status = nullptr);
 
 TF_Session* CreateSession(TF_Graph* graph, TF_Status* status = nullptr);
@@ -168,6 +204,87 @@ TF_Code RunSession(TF_Session* session,
                    const std::vector<const TF_Operation*>& target_opers,
                    TF_Status* status = nullptr);
 
+// Values of RunOptions.TraceLevel.
+enum class TraceLevel : std::int32_t {
+  NoTrace = 0,
+  SoftwareTrace = 1,
+  HardwareTrace = 2,
+  FullTrace = 3,
+};
+
+// Runs with RunOptions.trace_level set and stores the serialized RunMetadata proto in run_metadata.
+TF_Code RunSession(TF_Session* session,
+                   const std::vector<TF_Output>& inputs, const std::vector<TF_Tensor*>& input_tensors,
+                   const std::vector<TF_Output>& outputs, std::vector<TF_Tensor*>& output_tensors,
+                   TraceLevel trace_level, std::vector<std::uint8_t>& run_metadata,
+                   TF_Status* status = nullptr);
+
+// The RunOptions fields tf_utils can set. Default values are not encoded.
+struct RunOptions {
+  TraceLevel trace_level = TraceLevel::NoTrace;
+  std::chrono::milliseconds timeout{0}; // RunOptions.timeout_in_ms; zero means no deadline.
+  std::int32_t inter_op_thread_pool = 0; // Index into the session's session_inter_op_thread_pool list; -1 runs on the caller's thread.
+};
+
+TF_Code RunSession(TF_Session* session,
+                   const std::vector<TF_Output>& inputs, const std::vector<TF_Tensor*>& input_tensors,
+                   const std::vector<TF_Output>& outputs, std::vector<TF_Tensor*>& output_tensors,
+                   const RunOptions& options,
+                   TF_Status* status = nullptr);
+
+// Runs with RunOptions.timeout_in_ms set. A run that misses the deadline returns TF_DEADLINE_EXCEEDED.
+TF_Code RunSession(TF_Session* session,
+                   const std::vector<TF_Output>& inputs, const std::vector<TF_Tensor*>& input_tensors,
+                   const std::vector<TF_Output>& outputs, std::vector<TF_Tensor*>& output_tensors,
+                   std::chrono::milliseconds timeout,
+                   TF_Status* status = nullptr);
+
+// What a run hook sees. The pointers refer to the run's own arrays and are valid only during the hook call. Use
+// TF_OperationName on inputs[i].oper or outputs[i].oper for op names. output_tensors is null before the run;
+// duration, code and message are only set after it.
+struct RunHookContext {
+  TF_Session* session = nullptr;
+  const TF_Output* inputs = nullptr;
+  TF_Tensor* const* input_tensors = nullptr;
+  std::size_t num_inputs = 0;
+  const TF_Output* outputs = nullptr;
+  TF_Tensor* const* output_tensors = nullptr;
+  std::size_t num_outputs = 0;
+  const TF_Operation* const* target_opers = nullptr;
+  std::size_t num_targets = 0;
+  std::chrono::nanoseconds duration{0};
+  TF_Code code = TF_OK;
+  const char* message = "";
+};
+
+using RunHook = std::function<void(const RunHookContext&)>;
+
+// Registers hooks around every TF_SessionRun made by tf_utils: RunSession and everything built on it,
+// SharedSessionRunner and PreparedRun. Before hooks run in registration order and after hooks in reverse order,
+// both on the thread that runs the session, so a hook pair can keep per-run state in a thread_local. Either hook
+// may be empty. Hooks must not throw. Without registered hooks a run only pays for one relaxed atomic load, and
+// with hooks it reads the hook list atomically instead of taking the registry mutex.
+std::uint64_t AddRunHooks(RunHook before, RunHook after);
+
+// Returns false for an unknown id. Runs that already started may still call the removed hooks.
+bool RemoveRunHooks(std::uint64_t id);
+
+// One NodeExecStats entry of RunMetadata.step_stats. Times are in microseconds; the *_rel_* values are
+// relative to all_start_micros.
+struct NodeStepStats {
+  std::string device;
+  std::string node_name;
+  std::string timeline_label;
+  std::int64_t all_start_micros = 0;
+  std::int64_t op_start_rel_micros = 0;
+  std::int64_t op_end_rel_micros = 0;
+  std::int64_t all_end_rel_micros = 0;
+  std::uint32_t thread_id = 0;
+};
+
+// Decodes the per-node timings from a serialized RunMetadata proto. Returns false for malformed input.
+bool DecodeStepStats(const std::vector<std::uint8_t>& run_metadata, std::vector<NodeStepStats>& nodes);
+
 TF_Tensor* CreateTensor(TF_DataType data_type,
                         const std::int64_t* dims, std::size_t num_dims,
                         const void* data, std::size_t len);
@@ -194,10 +311,61 @@ TF_Tensor* CreateStringTensor(const std::vector<std::int64_t>& dims, const std::
 
 TF_Tensor* CreateStringTensor(const std::vector<std::int64_t>& dims, const std::vector<std::string>& strings);
 
+// Large files are memory-mapped and viewed in place until the tensor is deleted; small files are copied.
+TF_Tensor* CreateStringTensorFromFiles(const std::int64_t* dims, std::size_t num_dims,
+                                       const char* const* paths, std::size_t num_paths);
+
+TF_Tensor* CreateStringTensorFromFiles(const std::vector<std::int64_t>& dims, const std::vector<std::string>& paths);
+
+TF_Tensor* CreateStringTensorFromFiles(const std::vector<std::string>& paths);
+
 std::string GetStringTensorElement(const TF_Tensor* tensor, std::size_t index);
 
 std::vector<std::string> GetStringTensorData(const TF_Tensor* tensor);
 
+struct StringBucketBatch {
+  TF_Tensor* tokens = nullptr; // TF_STRING [batch, max_length], padded to the longest sequence in the batch.
+  TF_Tensor* lengths = nullptr; // TF_INT32 [batch].
+  TF_Tensor* mask = nullptr; // TF_INT32 [batch, max_length], 1 for real tokens and 0 for padding.
+  std::vector<std::size_t> request_indices; // Batch row to index in the input sequences.
+};
+
+// Groups sequences by the first bucket boundary not less than their length and builds one padded batch per bucket,
+// split into batches of at most max_batch_size rows when it is non-zero. Boundaries must be strictly increasing;
+// a sequence longer than the last boundary fails the whole call.
+bool CreateBucketedStringTensors(const std::vector<std::vector<std::string>>& sequences,
+                                 const std::vector<std::size_t>& bucket_boundaries,
+                                 std::vector<StringBucketBatch>& batches,
+                                 std::size_t max_batch_size = 0,
+                                 std::string_view padding = {});
+
+bool CreateBucketedStringTensors(const std::vector<std::vector<std::string_view>>& sequences,
+                                 const std::vector<std::size_t>& bucket_boundaries,
+                                 std::vector<StringBucketBatch>& batches,
+                                 std::size_t max_batch_size = 0,
+                                 std::string_view padding = {});
+
+void DeleteStringBucketBatches(std::vector<StringBucketBatch>& batches);
+
+// Packs strings of at most width bytes into a zero-padded TF_UINT8 [n, width] tensor and a TF_INT32 [n] lengths tensor.
+bool CreateFixedWidthStringTensors(const std::string_view* strings, std::size_t num_strings, std::size_t width,
+                                   TF_Tensor** bytes, TF_Tensor** lengths);
+
+bool CreateFixedWidthStringTensors(const std::vector<std::string_view>& strings, std::size_t width,
+                                   TF_Tensor** bytes, TF_Tensor** lengths);
+
+bool CreateFixedWidthStringTensors(const std::vector<std::string>& strings, std::size_t width,
+                                   TF_Tensor** bytes, TF_Tensor** lengths);
+
+std::vector<std::string> GetFixedWidthStringTensorData(const TF_Tensor* bytes, const TF_Tensor* lengths);
+
+// Exports a tensor as an Arrow array without validity bitmaps. Scalars and vectors become a flat array; a rank-n
+// tensor keeps its shape as n - 1 nested fixed_size_list levels ("+w:<dim>") over the flat values, so a [2, 3]
+// tensor is two lists of three values. On success the array owns the tensor: numeric data is shared in place,
+// TF_STRING is packed once into binary offsets/data and TF_BOOL into a bitmap. On failure the caller keeps
+// ownership of the tensor.
+bool ExportTensorToArrow(TF_Tensor* tensor, ArrowArray* array, ArrowSchema* schema = nullptr);
+
 TF_Tensor* CreateEmptyTensor(TF_DataType data_type, const std::int64_t* dims, std::size_t num_dims, std::size_t len = 0);
 
 TF_Tensor* CreateEmptyTensor(TF_DataType data_type, const std::vector<std::int64_t>& dims, std::size_t len = 0);
@@ -263,12 +431,651 @@ std::vector<std::int64_t> GetTensorShape(TF_Graph* graph, const TF_Output& outpu
 
 std::vector<std::vector<std::int64_t>> GetTensorsShape(TF_Graph* graph, const std::vector<TF_Output>& output);
 
+enum class WarmupFill {
+  Zeros,
+  Random, // Uniform [0, 1) for TF_FLOAT and TF_DOUBLE inputs; other types stay zero.
+};
+
+struct WarmupPass {
+  std::int64_t batch_size = 0;
+  std::size_t iteration = 0;
+  std::chrono::nanoseconds duration{0};
+  TF_Code code = TF_OK;
+};
+
+// Runs iterations passes per batch size with synthesized inputs: input shapes come from GetTensorShape and every
+// unknown dimension is replaced with the batch size. Fails with TF_INVALID_ARGUMENT before any run when an input's
+// rank is unknown, for example an unshaped Placeholder. Records one WarmupPass per run and stops at the first
+// failing run.
+TF_Code WarmupSession(TF_Session* session, TF_Graph* graph,
+                      const std::vector<TF_Output>& inputs, const std::vector<TF_Output>& outputs,
+                      const std::vector<std::int64_t>& batch_sizes, std::size_t iterations,
+                      std::vector<WarmupPass>& passes,
+                      WarmupFill fill = WarmupFill::Zeros,
+                      TF_Status* status = nullptr);
+
 TF_SessionOptions* CreateSessionOptions(double gpu_memory_fraction, TF_Status* status = nullptr);
 
 TF_SessionOptions* CreateSessionOptions(std::int32_t intra_op_parallelism_threads, std::int32_t inter_op_parallelism_threads, TF_Status* status = nullptr);
 
+// One ConfigProto.session_inter_op_thread_pool entry. Pools with the same non-empty global_name are shared
+// across sessions in the process.
+struct ThreadPoolOption {
+  std::int32_t num_threads = 0; // Zero lets TensorFlow pick.
+  std::string global_name;
+};
+
+// Declares one inter-op pool per entry; RunOptions.inter_op_thread_pool selects one per run, defaulting to the first.
+TF_SessionOptions* CreateSessionOptions(std::int32_t intra_op_parallelism_threads, const std::vector<ThreadPoolOption>& inter_op_thread_pools, TF_Status* status = nullptr);
+
+// OptimizerOptions.Level: L1 runs common subexpression elimination and constant folding, L0 disables both.
+enum class OptimizerLevel : std::int32_t {
+  L1 = 0,
+  L0 = -1,
+};
+
+// OptimizerOptions.GlobalJitLevel: On1 and On2 cluster subgraphs and compile them with XLA.
+enum class GlobalJitLevel : std::int32_t {
+  Default = 0,
+  Off = -1,
+  On1 = 1,
+  On2 = 2,
+};
+
+// RewriterConfig.Toggle for one Grappler optimizer. Default leaves the choice to TensorFlow.
+enum class RewriterToggle : std::int32_t {
+  Default = 0,
+  On = 1,
+  Off = 2,
+  Aggressive = 3,
+};
+
+// RewriterConfig.NumIterationsType: how many times the Grappler meta-optimizer runs its passes.
+enum class MetaOptimizerIterations : std::int32_t {
+  Default = 0,
+  One = 1,
+  Two = 2,
+};
+
+// Composes a ConfigProto one field at a time. Fields that are never set are left out of the encoding, so TensorFlow
+// keeps its own defaults for them; fields are serialized in field-number order.
+class SessionConfigBuilder {
+ public:
+  // ConfigProto.device_count: maximum number of devices of device_type ("CPU", "GPU") to use.
+  SessionConfigBuilder& SetDeviceCount(std::string device_type, std::int32_t count);
+  SessionConfigBuilder& SetIntraOpParallelismThreads(std::int32_t threads);
+  SessionConfigBuilder& SetInterOpParallelismThreads(std::int32_t threads);
+  SessionConfigBuilder& SetPerProcessGpuMemoryFraction(double gpu_memory_fraction);
+  SessionConfigBuilder& SetGpuAllowGrowth(bool allow_growth);
+  SessionConfigBuilder& SetAllowSoftPlacement(bool allow_soft_placement);
+  // Gives the session its own inter-op pool instead of the process-wide one.
+  SessionConfigBuilder& SetUsePerSessionThreads(bool use_per_session_threads);
+  SessionConfigBuilder& AddSessionInterOpThreadPool(ThreadPoolOption pool);
+  // Runs inter-op work on the process-wide pool global_name, shared by every session configured with the same name,
+  // and turns off per-session threads so intra-op work uses the process-wide pool as well. The first session creates
+  // the pool; TensorFlow rejects a later session that asks for a different num_threads.
+  SessionConfigBuilder& UseSharedInterOpThreadPool(std::string global_name, std::int32_t num_threads);
+  SessionConfigBuilder& SetIsolateSessionState(bool isolate_session_state);
+
+  // GraphOptions.optimizer_options.
+  SessionConfigBuilder& SetOptimizerLevel(OptimizerLevel level);
+  SessionConfigBuilder& SetDoCommonSubexpressionElimination(bool enabled);
+  SessionConfigBuilder& SetDoConstantFolding(bool enabled);
+  SessionConfigBuilder& SetDoFunctionInlining(bool enabled);
+  SessionConfigBuilder& SetGlobalJitLevel(GlobalJitLevel level);
+  // Applies the global jit level to CPU devices too; without it only GPU code is auto-clustered, unless
+  // TF_XLA_FLAGS contains --tf_xla_cpu_global_jit.
+  SessionConfigBuilder& SetCpuGlobalJit(bool enabled);
+
+  // GraphOptions.rewrite_options (Grappler).
+  SessionConfigBuilder& SetLayoutOptimizer(RewriterToggle toggle);
+  SessionConfigBuilder& SetConstantFolding(RewriterToggle toggle);
+  SessionConfigBuilder& SetArithmeticOptimization(RewriterToggle toggle);
+  // Fuses op patterns such as Conv2D + BiasAdd + Relu into single kernels.
+  SessionConfigBuilder& SetRemapping(RewriterToggle toggle);
+  // Rewrites eligible float ops to bfloat16 on CPUs with oneDNN bf16 support.
+  SessionConfigBuilder& SetAutoMixedPrecisionOnednnBfloat16(RewriterToggle toggle);
+  SessionConfigBuilder& SetMetaOptimizerIterations(MetaOptimizerIterations iterations);
+  // Time limit for optimizing one graph; zero or less never times out.
+  SessionConfigBuilder& SetMetaOptimizerTimeout(std::chrono::milliseconds timeout);
+  SessionConfigBuilder& SetDisableMetaOptimizer(bool disabled);
+  // Graphs with fewer nodes skip Grappler; -1 optimizes every graph.
+  SessionConfigBuilder& SetMinGraphNodes(std::int32_t min_graph_nodes);
+
+  // Serializes the ConfigProto into config. Returns TF_INVALID_ARGUMENT for negative thread or device counts and
+  // for gpu memory fractions outside [0.0, 1.0].
+  TF_Code Build(std::vector<std::uint8_t>& config, TF_Status* status = nullptr) const;
+
+  TF_SessionOptions* CreateSessionOptions(TF_Status* status = nullptr) const;
+
+ private:
+  std::map<std::string, std::int32_t> device_count_;
+  std::optional<std::int32_t> intra_op_parallelism_threads_;
+  std::optional<std::int32_t> inter_op_parallelism_threads_;
+  std::optional<double> per_process_gpu_memory_fraction_;
+  std::optional<bool> gpu_allow_growth_;
+  std::optional<bool> allow_soft_placement_;
+  std::optional<bool> use_per_session_threads_;
+  std::vector<ThreadPoolOption> session_inter_op_thread_pools_;
+  std::optional<bool> isolate_session_state_;
+  std::optional<OptimizerLevel> optimizer_level_;
+  std::optional<bool> do_common_subexpression_elimination_;
+  std::optional<bool> do_constant_folding_;
+  std::optional<bool> do_function_inlining_;
+  std::optional<GlobalJitLevel> global_jit_level_;
+  std::optional<bool> cpu_global_jit_;
+  std::optional<RewriterToggle> layout_optimizer_;
+  std::optional<RewriterToggle> constant_folding_;
+  std::optional<RewriterToggle> arithmetic_optimization_;
+  std::optional<RewriterToggle> remapping_;
+  std::optional<RewriterToggle> auto_mixed_precision_onednn_bfloat16_;
+  std::optional<MetaOptimizerIterations> meta_optimizer_iterations_;
+  std::optional<std::chrono::milliseconds> meta_optimizer_timeout_;
+  std::optional<bool> disable_meta_optimizer_;
+  std::optional<std::int32_t> min_graph_nodes_;
+};
+
 void DeleteSessionOptions(TF_SessionOptions* options);
 
+// A fixed set of sessions over one graph. Checkout and return go through a lock-free free list;
+// only callers that have to wait for a session touch the mutex.
+class SessionPool {
+ public:
+  // Returns its session to the pool when destroyed.
+  class Lease {
+   public:
+    Lease() = default;
+
+    Lease(const Lease&) = delete;
+
+    Lease& operator=(const Lease&) = delete;
+
+    Lease(Lease&& other) noexcept;
+
+    Lease& operator=(Lease&& other) noexcept;
+
+    ~Lease();
+
+    TF_Session* session() const;
+
+    std::size_t index() const {
+      return index_;
+    }
+
+    explicit operator bool() const {
+      return pool_ != nullptr;
+    }
+
+    void Release();
+
+   private:
+    friend class SessionPool;
+
+    Lease(SessionPool* pool, std::size_t index)
+        : pool_(pool), index_(index) {}
+
+    SessionPool* pool_ = nullptr;
+    std::size_t index_ = 0;
+  };
+
+  struct SessionUsage {
+    std::uint64_t checkouts = 0;
+    std::chrono::nanoseconds busy_time{0};
+    double utilization = 0.0; // Fraction of the pool lifetime the session was checked out.
+  };
+
+  SessionPool(const SessionPool&) = delete;
+
+  SessionPool& operator=(const SessionPool&) = delete;
+
+  ~SessionPool();
+
+  std::size_t size() const {
+    return size_;
+  }
+
+  Lease TryAcquire();
+
+  Lease Acquire();
+
+  // Returns an empty lease if no session became free within the timeout.
+  Lease Acquire(std::chrono::nanoseconds timeout);
+
+  std::vector<SessionUsage> Usage() const;
+
+ private:
+  friend SessionPool* CreateSessionPool(TF_Graph*, std::size_t, TF_SessionOptions*, TF_Status*);
+
+  struct alignas(64) Slot {
+    TF_Session* session = nullptr;
+    std::atomic<std::uint32_t> next{0};
+    std::atomic<std::uint64_t> checkouts{0};
+    std::atomic<std::int64_t> busy_ns{0};
+    std::atomic<std::int64_t> acquired_at_ns{0};
+  };
+
+  explicit SessionPool(std::size_t size);
+
+  bool Pop(std::size_t& index);
+
+  void Push(std::size_t index);
+
+  Lease Checkout(std::size_t index);
+
+  void Return(std::size_t index);
+
+  std::size_t size_;
+  std::unique_ptr<Slot[]> slots_;
+  std::atomic<std::uint64_t> head_{0}; // ABA tag in the high 32 bits, slot index + 1 in the low 32 bits.
+  std::atomic<std::size_t> waiters_{0};
+  std::mutex wait_mutex_;
+  std::condition_variable wait_cv_;
+  std::chrono::steady_clock::time_point created_at_;
+};
+
+// Runs one shared session from many threads. Inputs, outputs and targets are validated once at construction;
+// Run only calls TF_SessionRun. When no status is passed, Run reports through a per-thread status that is
+// reused across calls and readable with LastMessage() on the same thread.
+class SharedSessionRunner {
+ public:
+  SharedSessionRunner(TF_Session* session,
+                      std::vector<TF_Output> inputs,
+                      std::vector<TF_Output> outputs,
+                      std::vector<const TF_Operation*> target_opers = {});
+
+  std::size_t num_inputs() const {
+    return inputs_.size();
+  }
+
+  std::size_t num_outputs() const {
+    return outputs_.size();
+  }
+
+  // input_tensors must hold num_inputs() tensors and output_tensors room for num_outputs() tensors.
+  TF_Code Run(TF_Tensor* const* input_tensors, TF_Tensor** output_tensors, TF_Status* status = nullptr) const;
+
+  // Resizes output_tensors to num_outputs(); reusing the vector across calls avoids reallocating it.
+  TF_Code Run(const std::vector<TF_Tensor*>& input_tensors, std::vector<TF_Tensor*>& output_tensors, TF_Status* status = nullptr) const;
+
+  // Runs into the calling thread's scratch output array, which is reused across calls so steady-state runs do not
+  // allocate on the wrapper side. The scratch array owns the outputs until the next scratch Run on the same thread,
+  // from any runner, finishes and replaces them, so they may be fed to that run. A rejected call keeps them. Read
+  // them with ScratchOutput or keep one with ReleaseScratchOutput.
+  TF_Code Run(const std::vector<TF_Tensor*>& input_tensors, TF_Status* status = nullptr) const;
+
+  static TF_Tensor* ScratchOutput(std::size_t index);
+
+  // Transfers ownership of one scratch output to the caller.
+  static TF_Tensor* ReleaseScratchOutput(std::size_t index);
+
+  static const char* LastMessage();
+
+ private:
+  TF_Session* session_;
+  std::vector<TF_Output> inputs_;
+  std::vector<TF_Output> outputs_;
+  std::vector<const TF_Operation*> target_opers_;
+  bool valid_;
+};
+
+// Creates count sessions for graph with the same options. The graph must outlive the pool.
+SessionPool* CreateSessionPool(TF_Graph* graph, std::size_t count, TF_SessionOptions* options = nullptr, TF_Status* status = nullptr);
+
+// All leases must be released before the pool is deleted.
+void DeleteSessionPool(SessionPool* pool);
+
+// One fixed feed/fetch signature, resolved from operation names and validated once. Run only calls
+// TF_SessionRun: inputs, outputs, targets and the output array are preallocated and the status is reused,
+// so the wrapper itself does not allocate per call. Not thread-safe; use one PreparedRun per thread or
+// SharedSessionRunner for concurrent callers.
+class PreparedRun {
+ public:
+  PreparedRun(const PreparedRun&) = delete;
+
+  PreparedRun& operator=(const PreparedRun&) = delete;
+
+  ~PreparedRun();
+
+  std::size_t num_inputs() const {
+    return inputs_.size();
+  }
+
+  std::size_t num_outputs() const {
+    return outputs_.size();
+  }
+
+  // input_tensors must hold num_inputs() tensors. Outputs of the previous run are deleted once this run has
+  // finished, so they may be fed back as inputs; a rejected call keeps them.
+  TF_Code Run(TF_Tensor* const* input_tensors, TF_Status* status = nullptr);
+
+  TF_Code Run(const std::vector<TF_Tensor*>& input_tensors, TF_Status* status = nullptr);
+
+  // Owned by the PreparedRun and valid until the next Run returns.
+  TF_Tensor* output(std::size_t index) const {
+    return index < output_tensors_.size() ? output_tensors_[index] : nullptr;
+  }
+
+  // Transfers ownership of one output to the caller.
+  TF_Tensor* ReleaseOutput(std::size_t index);
+
+  // Message of the last Run that used the internal status.
+  const char* message() const;
+
+ private:
+  friend PreparedRun* CreatePreparedRun(TF_Session*, TF_Graph*,
+                                        const std::vector<std::string>&, const std::vector<std::string>&,
+                                        const std::vector<std::string>&, TF_Status*);
+
+  PreparedRun() = default;
+
+  TF_Session* session_ = nullptr;
+  std::vector<TF_Output> inputs_;
+  std::vector<TF_Output> outputs_;
+  std::vector<const TF_Operation*> target_opers_;
+  std::vector<TF_Tensor*> output_tensors_;
+  std::vector<TF_Tensor*> spare_output_tensors_; // The array a running call writes into.
+  TF_Status* status_ = nullptr;
+};
+
+// Names are "operation" or "operation:index". Fails with TF_INVALID_ARGUMENT when an operation is not in the graph.
+PreparedRun* CreatePreparedRun(TF_Session* session, TF_Graph* graph,
+                               const std::vector<std::string>& input_names,
+                               const std::vector<std::string>& output_names,
+                               const std::vector<std::string>& target_names = {},
+                               TF_Status* status = nullptr);
+
+void DeletePreparedRun(PreparedRun* run);
+
+// A TF_SessionPRun handle. Every feed and fetch is declared at setup; later Run calls feed some inputs and
+// fetch the outputs that are already computable, so early inputs do not wait for late ones.
+// Deletes the handle when destroyed.
+class PartialRun {
+ public:
+  PartialRun() = default;
+
+  PartialRun(const PartialRun&) = delete;
+
+  PartialRun& operator=(const PartialRun&) = delete;
+
+  PartialRun(PartialRun&& other) noexcept;
+
+  PartialRun& operator=(PartialRun&& other) noexcept;
+
+  ~PartialRun();
+
+  explicit operator bool() const {
+    return handle_ != nullptr;
+  }
+
+  // Each input may be fed and each output fetched at most once over the life of the handle.
+  TF_Code Run(const std::vector<TF_Output>& inputs, const std::vector<TF_Tensor*>& input_tensors,
+              const std::vector<TF_Output>& outputs, std::vector<TF_Tensor*>& output_tensors,
+              TF_Status* status = nullptr);
+
+  TF_Code Run(const std::vector<TF_Output>& inputs, const std::vector<TF_Tensor*>& input_tensors,
+              const std::vector<TF_Output>& outputs, std::vector<TF_Tensor*>& output_tensors,
+              const std::vector<const TF_Operation*>& target_opers,
+              TF_Status* status = nullptr);
+
+  void Reset();
+
+ private:
+  friend PartialRun SetupPartialRun(TF_Session*, const std::vector<TF_Output>&, const std::vector<TF_Output>&,
+                                    const std::vector<const TF_Operation*>&, TF_Status*);
+
+  PartialRun(TF_Session* session, const char* handle)
+      : session_(session), handle_(handle) {}
+
+  TF_Session* session_ = nullptr;
+  const char* handle_ = nullptr;
+};
+
+// Returns an empty PartialRun when setup fails.
+PartialRun SetupPartialRun(TF_Session* session,
+                           const std::vector<TF_Output>& inputs,
+                           const std::vector<TF_Output>& outputs,
+                           const std::vector<const TF_Operation*>& target_opers = {},
+                           TF_Status* status = nullptr);
+
+struct RunResult {
+  TF_Code code = TF_OK;
+  std::string message; // Only set when code is not TF_OK.
+  std::vector<TF_Tensor*> output_tensors; // Owned by the receiver, release with DeleteTensors.
+};
+
+// A fixed set of worker threads behind a bounded queue. When the queue is full, submission fails
+// instead of blocking, so callers can shed or delay load.
+class SessionExecutor {
+ public:
+  SessionExecutor(const SessionExecutor&) = delete;
+
+  SessionExecutor& operator=(const SessionExecutor&) = delete;
+
+  // Finishes every queued task before joining the workers.
+  ~SessionExecutor();
+
+  std::size_t num_threads() const {
+    return workers_.size();
+  }
+
+  std::size_t queue_capacity() const {
+    return queue_capacity_;
+  }
+
+  // Tasks waiting for a worker; running tasks are not counted.
+  std::size_t queue_depth() const;
+
+  // Returns false without running the task when the queue is full.
+  bool TrySubmit(std::function<void()> task);
+
+ private:
+  friend SessionExecutor* CreateSessionExecutor(std::size_t, std::size_t, TF_Status*);
+
+  explicit SessionExecutor(std::size_t queue_capacity);
+
+  void Work();
+
+  std::size_t queue_capacity_;
+  std::vector<std::thread> workers_;
+  std::deque<std::function<void()>> queue_;
+  mutable std::mutex mutex_;
+  std::condition_variable cv_;
+  bool stopping_ = false;
+};
+
+SessionExecutor* CreateSessionExecutor(std::size_t num_threads, std::size_t queue_capacity, TF_Status* status = nullptr);
+
+void DeleteSessionExecutor(SessionExecutor* executor);
+
+// Runs the session on an executor worker and calls done there with the result. Input tensors stay owned
+// by the caller and must stay alive until done is called. Returns TF_RESOURCE_EXHAUSTED without calling
+// done when the executor queue is full.
+TF_Code RunSessionAsync(SessionExecutor* executor, TF_Session* session,
+                        const std::vector<TF_Output>& inputs, const std::vector<TF_Tensor*>& input_tensors,
+                        const std::vector<TF_Output>& outputs,
+                        std::function<void(RunResult)> done,
+                        TF_Status* status = nullptr);
+
+// Returns an invalid future (valid() == false) and sets status when the run could not be queued.
+std::future<RunResult> RunSessionAsync(SessionExecutor* executor, TF_Session* session,
+                                       const std::vector<TF_Output>& inputs, const std::vector<TF_Tensor*>& input_tensors,
+                                       const std::vector<TF_Output>& outputs,
+                                       TF_Status* status = nullptr);
+
+// Runs one fixed signature on sessions of a pool through an executor. When a run has not finished after the
+// hedge delay, a duplicate run is issued on a second, idle session and whichever finishes first is returned; the
+// other run's outputs are deleted when it completes. The delay is the configured percentile of recent primary run
+// latencies. Hedges are skipped when max_concurrent_hedges are already in flight or no session is idle. Both runs
+// share the input tensors without copying them. The executor needs at least two workers and must be deleted before
+// the pool; the runner itself may be destroyed at any time.
+class HedgedRunner {
+ public:
+  struct Options {
+    double percentile = 95.0;
+    std::size_t window = 1024; // Primary run latencies the percentile is taken over.
+    std::size_t min_samples = 64; // Latencies needed before the percentile replaces initial_delay.
+    std::chrono::nanoseconds initial_delay = std::chrono::nanoseconds::max(); // The default never hedges.
+    std::size_t max_concurrent_hedges = 1;
+  };
+
+  struct Counters {
+    std::uint64_t runs = 0;
+    std::uint64_t hedges = 0;
+    std::uint64_t hedge_wins = 0; // Hedges that finished before their primary run.
+    std::uint64_t hedges_skipped = 0; // Runs past the delay that were not hedged because of the cap or a busy pool.
+
+    double hedge_rate() const {
+      return runs == 0 ? 0.0 : static_cast<double>(hedges) / static_cast<double>(runs);
+    }
+
+    double win_rate() const {
+      return hedges == 0 ? 0.0 : static_cast<double>(hedge_wins) / static_cast<double>(hedges);
+    }
+  };
+
+  HedgedRunner(SessionPool* pool, SessionExecutor* executor,
+               std::vector<TF_Output> inputs, std::vector<TF_Output> outputs,
+               Options options);
+
+  HedgedRunner(SessionPool* pool, SessionExecutor* executor,
+               std::vector<TF_Output> inputs, std::vector<TF_Output> outputs);
+
+  // Takes ownership of input_tensors, also on failure, and deletes them once the last run reading them completes,
+  // which may be after Run returned the other run's result. Resizes output_tensors to the output count. Blocks until
+  // a session is free for the primary run.
+  TF_Code Run(std::vector<TF_Tensor*>&& input_tensors, std::vector<TF_Tensor*>& output_tensors, TF_Status* status = nullptr);
+
+  std::chrono::nanoseconds hedge_delay() const;
+
+  Counters counters() const;
+
+ private:
+  struct State;
+
+  SessionPool* pool_;
+  SessionExecutor* executor_;
+  std::vector<TF_Output> inputs_;
+  std::vector<TF_Output> outputs_;
+  std::shared_ptr<State> state_; // Shared with runs still in flight.
+};
+
+// One session per NUMA node, each served by SessionExecutor workers pinned to the node's CPUs. The session and
+// executor of a node are created on a thread pinned to that node. By default TensorFlow runs every session's CPU
+// kernels on one process-wide intra-op pool that the first session creates, so with several nodes the group needs
+// TF_OVERRIDE_GLOBAL_THREADPOOL=1 in the environment before the process creates its first session. Then each
+// session creates its own intra-op pool, and its per-session inter-op pool, on the pinned thread; both inherit the
+// node's CPU mask and are sized to it. The first run, which allocates the graph's constants, happens on a node
+// worker. Without NUMA (not Linux, one node, or a CPU mask within one node) the group has a single unpinned node.
+class NumaSessionGroup {
+ public:
+  NumaSessionGroup(const NumaSessionGroup&) = delete;
+
+  NumaSessionGroup& operator=(const NumaSessionGroup&) = delete;
+
+  // Finishes every queued run before deleting the sessions.
+  ~NumaSessionGroup();
+
+  std::size_t num_nodes() const {
+    return num_nodes_;
+  }
+
+  // Operating system node id; -1 for the single-node fallback.
+  std::int32_t node_id(std::size_t node) const;
+
+  // CPUs the node's workers are pinned to; empty for the single-node fallback.
+  const std::vector<std::int32_t>& node_cpus(std::size_t node) const;
+
+  TF_Session* session(std::size_t node) const;
+
+  // Runs queued or running on the node.
+  std::size_t load(std::size_t node) const;
+
+  // The node with the fewest runs queued or running; ties go to the lowest index.
+  std::size_t LeastLoadedNode() const;
+
+  // CreateEmptyTensor for a fixed-size type, with the buffer bound to the node's memory with mbind. Returns null
+  // with TF_INTERNAL when the kernel rejects the binding; CreateEmptyTensor is the unbound fallback.
+  TF_Tensor* CreateTensor(std::size_t node, TF_DataType data_type, const std::vector<std::int64_t>& dims, TF_Status* status = nullptr) const;
+
+  // Queues the run on the node's workers and calls done there. Returns TF_RESOURCE_EXHAUSTED without calling
+  // done when the node's queue is full.
+  TF_Code RunAsync(std::size_t node,
+                   const std::vector<TF_Output>& inputs, const std::vector<TF_Tensor*>& input_tensors,
+                   const std::vector<TF_Output>& outputs,
+                   std::function<void(RunResult)> done,
+                   TF_Status* status = nullptr);
+
+  // Runs on the node's workers and waits for the result.
+  TF_Code Run(std::size_t node,
+              const std::vector<TF_Output>& inputs, const std::vector<TF_Tensor*>& input_tensors,
+              const std::vector<TF_Output>& outputs, std::vector<TF_Tensor*>& output_tensors,
+              TF_Status* status = nullptr);
+
+  // Runs on LeastLoadedNode().
+  TF_Code Run(const std::vector<TF_Output>& inputs, const std::vector<TF_Tensor*>& input_tensors,
+              const std::vector<TF_Output>& outputs, std::vector<TF_Tensor*>& output_tensors,
+              TF_Status* status = nullptr);
+
+ private:
+  friend NumaSessionGroup* CreateNumaSessionGroup(TF_Graph*, const SessionConfigBuilder&, std::size_t, std::size_t, TF_Status*);
+
+  struct alignas(64) Node {
+    std::int32_t id = -1;
+    std::vector<std::int32_t> cpus;
+    TF_Session* session = nullptr;
+    SessionExecutor* executor = nullptr;
+    std::atomic<std::size_t> load{0};
+  };
+
+  explicit NumaSessionGroup(std::size_t num_nodes);
+
+  std::size_t num_nodes_;
+  std::unique_ptr<Node[]> nodes_;
+};
+
+// Creates one session per NUMA node from config, with per-session threads turned on. workers_per_node 0 starts
+// one worker per CPU of the node; queue_capacity bounds the queue of every node. Fails with TF_FAILED_PRECONDITION
+// on a multi-node machine when TF_OVERRIDE_GLOBAL_THREADPOOL is not set.
+NumaSessionGroup* CreateNumaSessionGroup(TF_Graph* graph, const SessionConfigBuilder& config,
+                                         std::size_t workers_per_node = 0, std::size_t queue_capacity = 1024,
+                                         TF_Status* status = nullptr);
+
+void DeleteNumaSessionGroup(NumaSessionGroup* group);
+
+// Disjoint CPU sets for the work on an inference host, so preprocessing and TensorFlow do not evict each other's
+// caches. Empty preprocessing or session-run sets leave those threads unpinned.
+struct CpuPartition {
+  std::vector<std::int32_t> preprocessing_cpus;
+  std::vector<std::int32_t> session_run_cpus; // Threads that call TF_SessionRun.
+  std::vector<std::int32_t> tensorflow_cpus; // TensorFlow's intra-op and inter-op pools.
+};
+
+// Restricts the calling thread, and the threads it starts afterwards, to cpus with sched_setaffinity. Returns
+// TF_UNIMPLEMENTED on platforms other than Linux.
+TF_Code PinCurrentThreadToCpus(const std::vector<std::int32_t>& cpus, TF_Status* status = nullptr);
+
+// Splits the CPUs the process may run on, in order: preprocessing_count for preprocessing, session_run_count for
+// run callers and the rest for TensorFlow. Returns an empty partition when nothing is left for TensorFlow.
+CpuPartition PartitionAvailableCpus(std::size_t preprocessing_count, std::size_t session_run_count);
+
+// TF_INVALID_ARGUMENT when tensorflow_cpus is empty, the sets overlap, or a CPU is outside the process's CPU mask.
+TF_Code ValidateCpuPartition(const CpuPartition& partition, TF_Status* status = nullptr);
+
+// Creates a session whose pools run on partition.tensorflow_cpus: per-session threads, one intra-op thread per
+// TensorFlow CPU and one inter-op thread per run caller CPU (at least one). These counts override config. The
+// session is created on a thread pinned to the TensorFlow CPUs, and its pools inherit that CPU mask. TensorFlow
+// otherwise shares one intra-op pool, sized and pinned by the first session, across the process, so this needs
+// TF_OVERRIDE_GLOBAL_THREADPOOL=1 set before the process creates its first session and fails with
+// TF_FAILED_PRECONDITION without it.
+TF_Session* CreatePartitionedSession(TF_Graph* graph, const CpuPartition& partition,
+                                     const SessionConfigBuilder& config = {}, TF_Status* status = nullptr);
+
+// A SessionExecutor whose workers are pinned to cpus, for example partition.session_run_cpus for TF_SessionRun
+// callers (through RunSessionAsync) or partition.preprocessing_cpus for preprocessing tasks (through TrySubmit).
+// num_threads 0 starts one worker per CPU.
+SessionExecutor* CreatePinnedSessionExecutor(const std::vector<std::int32_t>& cpus, std::size_t num_threads = 0,
+                                             std::size_t queue_capacity = 1024, TF_Status* status = nullptr);
+
 const char* DataTypeToString(TF_DataType data_type);
 
 const char* CodeToString(TF_Code code);
@@ -0,0 +1,108 @@
+// Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2018 - 2026 Daniil Goncharov <neargye@gmail.com>.
+//
+// Permission is hereby  granted, free of charge, to any  person obtaining a copy
+// of this software and associated  documentation files (the "Software"), to deal
+// in the Software  without restriction, including without  limitation the rights
+// to  use, copy,  modify, merge,  publish, distribute,  sublicense, and/or  sell
+// copies  of  the Software,  and  to  permit persons  to  whom  the Software  is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE  IS PROVIDED "AS  IS", WITHOUT WARRANTY  OF ANY KIND,  EXPRESS OR
+// IMPLIED,  INCLUDING BUT  NOT  LIMITED TO  THE  WARRANTIES OF  MERCHANTABILITY,
+// FITNESS FOR  A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT  SHALL THE
+// AUTHORS  OR COPYRIGHT  HOLDERS  BE  LIABLE FOR  ANY  CLAIM,  DAMAGES OR  OTHER
+// LIABILITY, WHETHER IN AN ACTION OF  CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE  OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+// Optional C++20 coroutine support for tf_utils. Include only from translation units built as C++20;
+// the hello_tf_utils library itself stays C++17.
+
+#if !defined(__cpp_impl_coroutine) || !__has_include(<coroutine>)
+#  error "tf_utils_coro.hpp requires C++20 coroutine support."
+#endif
+
+#include "tf_utils.hpp"
+#include <coroutine>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace tf_utils {
+
+// co_await RunSessionAwaitable(...) suspends the coroutine, runs the session on a SessionExecutor worker and
+// resumes with the RunResult. With a resume function the coroutine is handed back to it, which may post it onto
+// an event loop or resume it inline; without one it resumes on the worker thread. If the run cannot be queued,
+// the coroutine is not suspended and the result carries the error, TF_RESOURCE_EXHAUSTED when the executor queue
+// is full.
+// Input tensors stay owned by the caller and must stay alive until the coroutine resumes.
+class RunSessionAwaitable {
+ public:
+  using ResumeFunction = std::function<void(std::coroutine_handle<>)>;
+
+  RunSessionAwaitable(SessionExecutor* executor, TF_Session* session,
+                      std::vector<TF_Output> inputs, std::vector<TF_Tensor*> input_tensors,
+                      std::vector<TF_Output> outputs,
+                      ResumeFunction resume = {})
+      : executor_(executor),
+        session_(session),
+        inputs_(std::move(inputs)),
+        input_tensors_(std::move(input_tensors)),
+        outputs_(std::move(outputs)),
+        resume_(std::move(resume)) {}
+
+  RunSessionAwaitable(const RunSessionAwaitable&) = delete;
+
+  RunSessionAwaitable& operator=(const RunSessionAwaitable&) = delete;
+
+  bool await_ready() const noexcept {
+    return false;
+  }
+
+  bool await_suspend(std::coroutine_handle<> handle) {
+    const std::unique_ptr<TF_Status, decltype(&TF_DeleteStatus)> status(TF_NewStatus(), TF_DeleteStatus);
+    const auto code = RunSessionAsync(executor_, session_, inputs_, input_tensors_, outputs_,
+                                      [this, handle](RunResult result) {
+                                        // Resuming may destroy this awaitable, so nothing reaches this afterwards.
+                                        auto resume = std::move(resume_);
+                                        result_ = std::move(result);
+                                        if (resume) {
+                                          resume(handle);
+                                        } else {
+                                          handle.resume();
+                                        }
+                                      },
+                                      status.get());
+    if (code == TF_OK) {
+      // The worker may already have resumed the coroutine and destroyed this awaitable.
+      return true;
+    }
+
+    result_.code = code;
+    result_.message = status == nullptr ? "" : TF_Message(status.get());
+    return false;
+  }
+
+  RunResult await_resume() {
+    return std::move(result_);
+  }
+
+ private:
+  SessionExecutor* executor_;
+  TF_Session* session_;
+  std::vector<TF_Output> inputs_;
+  std::vector<TF_Tensor*> input_tensors_;
+  std::vector<TF_Output> outputs_;
+  ResumeFunction resume_;
+  RunResult result_;
+};
+
+} // namespace tf_utils
@@ -0,0 +1,135 @@
+// Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2018 - 2026 Daniil Goncharov <neargye@gmail.com>.
+//
+// Permission is hereby  granted, free of charge, to any  person obtaining a copy
+// of this software and associated  documentation files (the "Software"), to deal
+// in the Software  without restriction, including without  limitation the rights
+// to  use, copy,  modify, merge,  publish, distribute,  sublicense, and/or  sell
+// copies  of  the Software,  and  to  permit persons  to  whom  the Software  is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE  IS PROVIDED "AS  IS", WITHOUT WARRANTY  OF ANY KIND,  EXPRESS OR
+// IMPLIED,  INCLUDING BUT  NOT  LIMITED TO  THE  WARRANTIES OF  MERCHANTABILITY,
+// FITNESS FOR  A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT  SHALL THE
+// AUTHORS  OR COPYRIGHT  HOLDERS  BE  LIABLE FOR  ANY  CLAIM,  DAMAGES OR  OTHER
+// LIABILITY, WHETHER IN AN ACTION OF  CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE  OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest.h>
+
+#if defined(_MSC_VER) && !defined(COMPILER_MSVC)
+#  define COMPILER_MSVC // Set MSVC visibility of exported symbols in the shared library.
+#endif
+
+#if defined(_MSC_VER)
+#  pragma warning(push)
+#  pragma warning(disable : 4190)
+#endif
+
+#include <tensorflow/c/c_api.h> // TensorFlow C API header.
+
+#if defined(_MSC_VER)
+#  pragma warning(pop)
+#endif
+
+#include "tf_utils.hpp"
+#include "bench_utils.hpp"
+#include <scope_guard.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace {
+
+TF_Operation* AddPlaceholder(TF_Graph* graph, const char* name, TF_DataType data_type, TF_Status* status) {
+  auto desc = TF_NewOperation(graph, "Placeholder", name);
+  TF_SetAttrType(desc, "dtype", data_type);
+
+  return TF_FinishOperation(desc, status);
+}
+
+TF_Operation* AddIdentity(TF_Graph* graph, const char* name, TF_Output input, TF_DataType data_type, TF_Status* status) {
+  auto desc = TF_NewOperation(graph, "Identity", name);
+  TF_SetAttrType(desc, "T", data_type);
+  TF_AddInput(desc, input);
+
+  return TF_FinishOperation(desc, status);
+}
+
+// Fewest allocations seen in one call of run over iterations calls. The minimum ignores allocations made by
+// TensorFlow background threads that happen to land inside one measured call.
+template <typename Run>
+std::uint64_t MinAllocationsPerCall(int iterations, Run run) {
+  auto fewest = std::numeric_limits<std::uint64_t>::max();
+  for (int i = 0; i < iterations; ++i) {
+    const auto before = bench::AllocationCount();
+    run();
+    fewest = std::min(fewest, bench::AllocationCount() - before);
+  }
+
+  return fewest;
+}
+
+} // namespace
+
+TEST_CASE("Entry points without a caller status do not allocate one per call") {
+  auto status = TF_NewStatus();
+  SCOPE_EXIT{ TF_DeleteStatus(status); };
+
+  auto graph = TF_NewGraph();
+  SCOPE_EXIT{ TF_DeleteGraph(graph); };
+
+  auto input = AddPlaceholder(graph, "input", TF_FLOAT, status);
+  REQUIRE(TF_GetCode(status) == TF_OK);
+  auto output = AddIdentity(graph, "output", TF_Output{input, 0}, TF_FLOAT, status);
+  REQUIRE(TF_GetCode(status) == TF_OK);
+
+  auto session = tf_utils::CreateSession(graph, status);
+  SCOPE_EXIT{ tf_utils::DeleteSession(session); };
+  REQUIRE(session != nullptr);
+
+  const TF_Output inputs[] = {TF_Output{input, 0}};
+  const TF_Output outputs[] = {TF_Output{output, 0}};
+  const std::vector<float> values = {1.0f, 2.0f, 3.0f};
+  TF_Tensor* input_tensors[] = {tf_utils::CreateTensor(TF_FLOAT, std::vector<std::int64_t>{3}, values)};
+  SCOPE_EXIT{ tf_utils::DeleteTensor(input_tensors[0]); };
+  TF_Tensor* output_tensors[] = {nullptr};
+
+  const auto run = [&](TF_Status* run_status) {
+    const auto code = tf_utils::RunSession(session, inputs, input_tensors, 1, outputs, output_tensors, 1, run_status);
+    tf_utils::DeleteTensor(output_tensors[0]);
+    output_tensors[0] = nullptr;
+    return code;
+  };
+
+  // Warm up the session and the thread-local status.
+  for (int i = 0; i < 10; ++i) {
+    REQUIRE(run(nullptr) == TF_OK);
+    REQUIRE(run(status) == TF_OK);
+  }
+
+  constexpr int iterations = 200;
+  const auto with_caller_status = MinAllocationsPerCall(iterations, [&] { run(status); });
+  const auto without_status = MinAllocationsPerCall(iterations, [&] { run(nullptr); });
+  CHECK(without_status == with_caller_status);
+
+  const TF_Output shape_output = {input, 0};
+  const auto shape_allocations = MinAllocationsPerCall(iterations, [&] {
+    tf_utils::GetTensorShape(graph, shape_output);
+  });
+  const auto caller_shape_allocations = MinAllocationsPerCall(iterations, [&] {
+    const auto num_dims = TF_GraphGetTensorNumDims(graph, shape_output, status);
+    if (num_dims >= 0) {
+      std::vector<std::int64_t> dims(static_cast<std::size_t>(num_dims));
+      TF_GraphGetTensorShape(graph, shape_output, dims.data(), num_dims, status);
+    }
+  });
+  CHECK(shape_allocations == caller_shape_allocations);
+}
@@ -0,0 +1,274 @@
+// Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2018 - 2026 Daniil Goncharov <neargye@gmail.com>.
+//
+// Permission is hereby  granted, free of charge, to any  person obtaining a copy
+// of this software and associated  documentation files (the "Software"), to deal
+// in the Software  without restriction, including without  limitation the rights
+// to  use, copy,  modify, merge,  publish, distribute,  sublicense, and/or  sell
+// copies  of  the Software,  and  to  permit persons  to  whom  the Software  is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE  IS PROVIDED "AS  IS", WITHOUT WARRANTY  OF ANY KIND,  EXPRESS OR
+// IMPLIED,  INCLUDING BUT  NOT  LIMITED TO  THE  WARRANTIES OF  MERCHANTABILITY,
+// FITNESS FOR  A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT  SHALL THE
+// AUTHORS  OR COPYRIGHT  HOLDERS  BE  LIABLE FOR  ANY  CLAIM,  DAMAGES OR  OTHER
+// LIABILITY, WHETHER IN AN ACTION OF  CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE  OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest.h>
+
+#if defined(_MSC_VER) && !defined(COMPILER_MSVC)
+#  define COMPILER_MSVC // Set MSVC visibility of exported symbols in the shared library.
+#endif
+
+#if defined(_MSC_VER)
+#  pragma warning(push)
+#  pragma warning(disable : 4190)
+#endif
+
+#include <tensorflow/c/c_api.h> // TensorFlow C API header.
+
+#if defined(_MSC_VER)
+#  pragma warning(pop)
+#endif
+
+#include "tf_utils_coro.hpp"
+#include <scope_guard.hpp>
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// Starts eagerly and destroys itself when it finishes.
+struct DetachedTask {
+  struct promise_type {
+    DetachedTask get_return_object() noexcept {
+      return {};
+    }
+
+    std::suspend_never initial_suspend() noexcept {
+      return {};
+    }
+
+    std::suspend_never final_suspend() noexcept {
+      return {};
+    }
+
+    void return_void() noexcept {}
+
+    void unhandled_exception() noexcept {
+      std::terminate();
+    }
+  };
+};
+
+// Single-threaded executor standing in for an event loop: resumptions are queued and run by Drain().
+class ResumeQueue {
+ public:
+  void Post(std::coroutine_handle<> handle) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    handles_.push_back(handle);
+  }
+
+  std::size_t Drain() {
+    std::deque<std::coroutine_handle<>> handles;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      handles.swap(handles_);
+    }
+    for (auto handle : handles) {
+      handle.resume();
+    }
+
+    return handles.size();
+  }
+
+ private:
+  std::mutex mutex_;
+  std::deque<std::coroutine_handle<>> handles_;
+};
+
+TF_Operation* AddPlaceholder(TF_Graph* graph, const char* name, TF_DataType data_type, TF_Status* status) {
+  auto desc = TF_NewOperation(graph, "Placeholder", name);
+  TF_SetAttrType(desc, "dtype", data_type);
+
+  return TF_FinishOperation(desc, status);
+}
+
+TF_Operation* AddIdentity(TF_Graph* graph, const char* name, TF_Output input, TF_DataType data_type, TF_Status* status) {
+  auto desc = TF_NewOperation(graph, "Identity", name);
+  TF_SetAttrType(desc, "T", data_type);
+  TF_AddInput(desc, input);
+
+  return TF_FinishOperation(desc, status);
+}
+
+DetachedTask RunOnce(tf_utils::SessionExecutor* executor, TF_Session* session,
+                     TF_Output input, TF_Output output, TF_Tensor* input_tensor, float expected,
+                     ResumeQueue& resume_queue, std::thread::id caller, std::atomic<int>& completed, std::atomic<int>& failures) {
+  std::vector<TF_Output> inputs(1, input);
+  std::vector<TF_Tensor*> input_tensors(1, input_tensor);
+  std::vector<TF_Output> outputs(1, output);
+  auto result = co_await tf_utils::RunSessionAwaitable(executor, session, std::move(inputs), std::move(input_tensors), std::move(outputs),
+                                                       [&resume_queue](std::coroutine_handle<> handle) {
+                                                         resume_queue.Post(handle);
+                                                       });
+  if (result.code != TF_OK ||
+      std::this_thread::get_id() != caller ||
+      tf_utils::GetTensorData<float>(result.output_tensors[0]) != std::vector<float>{expected}) {
+    ++failures;
+  }
+  tf_utils::DeleteTensors(result.output_tensors);
+  ++completed;
+}
+
+DetachedTask RunExpectingCode(tf_utils::SessionExecutor* executor, TF_Session* session,
+                              TF_Output input, TF_Output output, TF_Tensor* input_tensor, std::promise<TF_Code>& code,
+                              tf_utils::RunSessionAwaitable::ResumeFunction resume = {}) {
+  std::vector<TF_Output> inputs(1, input);
+  std::vector<TF_Tensor*> input_tensors(1, input_tensor);
+  std::vector<TF_Output> outputs(1, output);
+  auto result = co_await tf_utils::RunSessionAwaitable(executor, session, std::move(inputs), std::move(input_tensors), std::move(outputs),
+                                                       std::move(resume));
+  tf_utils::DeleteTensors(result.output_tensors);
+  code.set_value(result.code);
+}
+
+} // namespace
+
+TEST_CASE("RunSessionAwaitable resumes coroutines on the caller's executor") {
+  auto status = TF_NewStatus();
+  SCOPE_EXIT{ TF_DeleteStatus(status); };
+
+  auto graph = TF_NewGraph();
+  SCOPE_EXIT{ TF_DeleteGraph(graph); };
+
+  auto input = AddPlaceholder(graph, "input", TF_FLOAT, status);
+  REQUIRE(TF_GetCode(status) == TF_OK);
+  auto output = AddIdentity(graph, "output", TF_Output{input, 0}, TF_FLOAT, status);
+  REQUIRE(TF_GetCode(status) == TF_OK);
+
+  auto session = tf_utils::CreateSession(graph, status);
+  SCOPE_EXIT{ tf_utils::DeleteSession(session); };
+  REQUIRE(session != nullptr);
+
+  constexpr int request_count = 256;
+  auto executor = tf_utils::CreateSessionExecutor(2, request_count, status);
+  SCOPE_EXIT{ tf_utils::DeleteSessionExecutor(executor); };
+  REQUIRE(executor != nullptr);
+
+  std::vector<TF_Tensor*> input_tensors;
+  SCOPE_EXIT{ tf_utils::DeleteTensors(input_tensors); };
+  for (int i = 0; i < request_count; ++i) {
+    input_tensors.push_back(tf_utils::CreateTensor(TF_FLOAT, std::vector<std::int64_t>{1}, std::vector<float>{static_cast<float>(i)}));
+  }
+
+  ResumeQueue resume_queue;
+  std::atomic<int> completed{0};
+  std::atomic<int> failures{0};
+  for (int i = 0; i < request_count; ++i) {
+    RunOnce(executor, session, TF_Output{input, 0}, TF_Output{output, 0}, input_tensors[i], static_cast<float>(i),
+            resume_queue, std::this_thread::get_id(), completed, failures);
+  }
+  while (completed.load() != request_count) {
+    if (resume_queue.Drain() == 0) {
+      std::this_thread::yield();
+    }
+  }
+
+  CHECK(failures.load() == 0);
+}
+
+TEST_CASE("RunSessionAwaitable does not suspend when the executor queue is full") {
+  auto status = TF_NewStatus();
+  SCOPE_EXIT{ TF_DeleteStatus(status); };
+
+  auto graph = TF_NewGraph();
+  SCOPE_EXIT{ TF_DeleteGraph(graph); };
+
+  auto input = AddPlaceholder(graph, "input", TF_FLOAT, status);
+  REQUIRE(TF_GetCode(status) == TF_OK);
+  auto output = AddIdentity(graph, "output", TF_Output{input, 0}, TF_FLOAT, status);
+  REQUIRE(TF_GetCode(status) == TF_OK);
+
+  auto session = tf_utils::CreateSession(graph, status);
+  SCOPE_EXIT{ tf_utils::DeleteSession(session); };
+  REQUIRE(session != nullptr);
+
+  auto executor = tf_utils::CreateSessionExecutor(1, 1, status);
+  SCOPE_EXIT{ tf_utils::DeleteSessionExecutor(executor); };
+  REQUIRE(executor != nullptr);
+
+  auto input_tensor = tf_utils::CreateTensor(TF_FLOAT, std::vector<std::int64_t>{1}, std::vector<float>{1.0f});
+  SCOPE_EXIT{ tf_utils::DeleteTensor(input_tensor); };
+
+  std::promise<void> release_worker;
+  std::promise<void> worker_busy;
+  REQUIRE(executor->TrySubmit([&] {
+    worker_busy.set_value();
+    release_worker.get_future().wait();
+  }));
+  worker_busy.get_future().wait();
+  REQUIRE(executor->TrySubmit([] {}));
+
+  std::promise<TF_Code> rejected;
+  RunExpectingCode(executor, session, TF_Output{input, 0}, TF_Output{output, 0}, input_tensor, rejected);
+  auto rejected_code = rejected.get_future();
+  REQUIRE(rejected_code.wait_for(std::chrono::seconds(0)) == std::future_status::ready);
+  CHECK(rejected_code.get() == TF_RESOURCE_EXHAUSTED);
+
+  release_worker.set_value();
+  while (executor->queue_depth() != 0) {
+    std::this_thread::yield();
+  }
+  std::promise<TF_Code> accepted;
+  RunExpectingCode(executor, session, TF_Output{input, 0}, TF_Output{output, 0}, input_tensor, accepted);
+  CHECK(accepted.get_future().get() == TF_OK);
+}
+
+TEST_CASE("RunSessionAwaitable allows a resume function that resumes inline") {
+  auto status = TF_NewStatus();
+  SCOPE_EXIT{ TF_DeleteStatus(status); };
+
+  auto graph = TF_NewGraph();
+  SCOPE_EXIT{ TF_DeleteGraph(graph); };
+
+  auto input = AddPlaceholder(graph, "input", TF_FLOAT, status);
+  REQUIRE(TF_GetCode(status) == TF_OK);
+  auto output = AddIdentity(graph, "output", TF_Output{input, 0}, TF_FLOAT, status);
+  REQUIRE(TF_GetCode(status) == TF_OK);
+
+  auto session = tf_utils::CreateSession(graph, status);
+  SCOPE_EXIT{ tf_utils::DeleteSession(session); };
+  REQUIRE(session != nullptr);
+
+  auto executor = tf_utils::CreateSessionExecutor(1, 4, status);
+  SCOPE_EXIT{ tf_utils::DeleteSessionExecutor(executor); };
+  REQUIRE(executor != nullptr);
+
+  auto input_tensor = tf_utils::CreateTensor(TF_FLOAT, std::vector<std::int64_t>{1}, std::vector<float>{1.0f});
+  SCOPE_EXIT{ tf_utils::DeleteTensor(input_tensor); };
+
+  // The coroutine finishes, and destroys the awaitable with its resume function, before the function returns.
+  for (int i = 0; i < 8; ++i) {
+    std::promise<TF_Code> code;
+    RunExpectingCode(executor, session, TF_Output{input, 0}, TF_Output{output, 0}, input_tensor, code,
+                     [](std::coroutine_handle<> handle) { handle.resume(); });
+    CHECK(code.get_future().get() == TF_OK);
+  }
+}
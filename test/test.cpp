@@ -39,13 +39,27 @@
 #endif
 
 #include "tf_utils.hpp"
+#include <arrow/c/abi.h>
 #include <scope_guard.hpp>
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <future>
 #include <limits>
 #include <string>
 #include <string_view>
+#include <thread>
 #include <vector>
 
+#if defined(__linux__)
+#  include <sched.h>
+#endif
+
 namespace {
 
 TF_Operation* AddPlaceholder(TF_Graph* graph, const char* name, TF_DataType data_type, TF_Status* status) {
@@ -63,6 +77,15 @@ TF_Operation* AddIdentity(TF_Graph* graph, const char* name, TF_Output input, TF
   return TF_FinishOperation(desc, status);
 }
 
+TF_Operation* AddMul(TF_Graph* graph, const char* name, TF_Output x, TF_Output y, TF_Status* status) {
+  auto desc = TF_NewOperation(graph, "Mul", name);
+  TF_SetAttrType(desc, "T", TF_FLOAT);
+  TF_AddInput(desc, x);
+  TF_AddInput(desc, y);
+
+  return TF_FinishOperation(desc, status);
+}
+
 TF_Operation* AddFloatConst(TF_Graph* graph, const char* name, float value, TF_Status* status) {
   const std::vector<std::int64_t> dims = {};
   const std::vector<float> values = {value};
@@ -113,6 +136,19 @@ TF_Operation* AddReadVariable(TF_Graph* graph, const char* name, TF_Output varia
   return TF_FinishOperation(desc, status);
 }
 
+// Sets an environment variable of the test process, or removes it when value is null.
+void SetEnvironmentVariable(const char* name, const char* value) {
+#if defined(_WIN32)
+  _putenv_s(name, value == nullptr ? "" : value);
+#else
+  if (value == nullptr) {
+    unsetenv(name);
+  } else {
+    setenv(name, value, 1);
+  }
+#endif
+}
+
 } // namespace
 
 TEST_CASE("Hello TF C API") {
@@ -348,6 +384,56 @@ TEST_CASE("CreateSessionOptions helpers create usable TensorFlow session options
   REQUIRE(owned_status_options != nullptr);
 }
 
+TEST_CASE("RunOptions selects one of several session inter-op thread pools") {
+  auto status = TF_NewStatus();
+  SCOPE_EXIT{ TF_DeleteStatus(status); };
+
+  CHECK(tf_utils::CreateSessionOptions(1, std::vector<tf_utils::ThreadPoolOption>{}, status) == nullptr);
+  CHECK(TF_GetCode(status) == TF_INVALID_ARGUMENT);
+  TF_SetStatus(status, TF_OK, "");
+  CHECK(tf_utils::CreateSessionOptions(1, {{-1, ""}}, status) == nullptr);
+  CHECK(TF_GetCode(status) == TF_INVALID_ARGUMENT);
+  TF_SetStatus(status, TF_OK, "");
+
+  auto graph = TF_NewGraph();
+  SCOPE_EXIT{ TF_DeleteGraph(graph); };
+
+  auto input = AddPlaceholder(graph, "input", TF_FLOAT, status);
+  REQUIRE(TF_GetCode(status) == TF_OK);
+  auto output = AddIdentity(graph, "output", TF_Output{input, 0}, TF_FLOAT, status);
+  REQUIRE(TF_GetCode(status) == TF_OK);
+
+  // A small pool for interactive requests and a wide one for batch work.
+  auto options = tf_utils::CreateSessionOptions(1, {{1, ""}, {4, ""}}, status);
+  SCOPE_EXIT{ tf_utils::DeleteSessionOptions(options); };
+  REQUIRE(options != nullptr);
+
+  auto session = tf_utils::CreateSession(graph, options, status);
+  SCOPE_EXIT{ tf_utils::DeleteSession(session); };
+  REQUIRE(session != nullptr);
+
+  const std::vector<TF_Tensor*> input_tensors = {tf_utils::CreateTensor(TF_FLOAT, std::vector<std::int64_t>{1}, std::vector<float>{2.0f})};
+  SCOPE_EXIT{ tf_utils::DeleteTensors(input_tensors); };
+
+  // -1 runs the step on the caller's thread instead of an inter-op pool.
+  for (std::int32_t pool = -1; pool < 2; ++pool) {
+    std::vector<TF_Tensor*> output_tensors = {nullptr};
+    SCOPE_EXIT{ tf_utils::DeleteTensors(output_tensors); };
+
+    tf_utils::RunOptions run_options;
+    run_options.inter_op_thread_pool = pool;
+    REQUIRE(tf_utils::RunSession(session, {TF_Output{input, 0}}, input_tensors, {TF_Output{output, 0}}, output_tensors,
+                                 run_options, status) == TF_OK);
+    CHECK(tf_utils::GetTensorData<float>(output_tensors[0]) == std::vector<float>{2.0f});
+  }
+
+  std::vector<TF_Tensor*> output_tensors = {nullptr};
+  tf_utils::RunOptions invalid_options;
+  invalid_options.inter_op_thread_pool = -2;
+  CHECK(tf_utils::RunSession(session, {TF_Output{input, 0}}, input_tensors, {TF_Output{output, 0}}, output_tensors,
+                             invalid_options, status) == TF_INVALID_ARGUMENT);
+}
+
 TEST_CASE("CreateSessionOptions rejects invalid gpu memory fractions") {
   auto status = TF_NewStatus();
   SCOPE_EXIT{ TF_DeleteStatus(status); };
@@ -380,6 +466,141 @@ TEST_CASE("CreateSessionOptions rejects negative thread counts") {
   CHECK(TF_GetCode(status) == TF_INVALID_ARGUMENT);
 }
 
+TEST_CASE("SessionConfigBuilder encodes ConfigProto fields") {
+  auto status = TF_NewStatus();
+  SCOPE_EXIT{ TF_DeleteStatus(status); };
+
+  std::vector<std::uint8_t> config = {0xff};
+  REQUIRE(tf_utils::SessionConfigBuilder().Build(config, status) == TF_OK);
+  CHECK(config.empty());
+
+  // Matches the config CreateSessionOptions(double) has always sent.
+  REQUIRE(tf_utils::SessionConfigBuilder()
+              .SetAllowSoftPlacement(true)
+              .SetGpuAllowGrowth(true)
+              .SetPerProcessGpuMemoryFraction(0.25)
+              .Build(config, status) == TF_OK);
+  CHECK(config == std::vector<std::uint8_t>{0x32, 0x0b, 0x09, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xd0, 0x3f, 0x20, 0x01, 0x38, 0x01});
+
+  REQUIRE(tf_utils::SessionConfigBuilder()
+              .SetIsolateSessionState(true)
+              .AddSessionInterOpThreadPool({3, "shared"})
+              .SetDisableMetaOptimizer(true)
+              .SetDoConstantFolding(false)
+              .SetOptimizerLevel(tf_utils::OptimizerLevel::L0)
+              .SetUsePerSessionThreads(false)
+              .SetAllowSoftPlacement(true)
+              .SetInterOpParallelismThreads(2)
+              .SetIntraOpParallelismThreads(4)
+              .SetDeviceCount("CPU", 2)
+              .Build(config, status) == TF_OK);
+  const std::vector<std::uint8_t> expected = {
+      0x0a, 0x07, 0x0a, 0x03, 'C', 'P', 'U', 0x10, 0x02, // device_count {"CPU": 2}
+      0x10, 0x04, // intra_op_parallelism_threads
+      0x28, 0x02, // inter_op_parallelism_threads
+      0x38, 0x01, // allow_soft_placement
+      0x48, 0x00, // use_per_session_threads
+      0x52, 0x14, // graph_options
+      0x1a, 0x0d, 0x10, 0x00, 0x18, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x01, // optimizer_options
+      0x52, 0x03, 0x98, 0x01, 0x01, // rewrite_options.disable_meta_optimizer
+      0x62, 0x0a, 0x08, 0x03, 0x12, 0x06, 's', 'h', 'a', 'r', 'e', 'd', // session_inter_op_thread_pool
+      0x78, 0x01, // isolate_session_state
+  };
+  CHECK(config == expected);
+
+  REQUIRE(tf_utils::SessionConfigBuilder()
+              .SetCpuGlobalJit(true)
+              .SetGlobalJitLevel(tf_utils::GlobalJitLevel::On1)
+              .Build(config, status) == TF_OK);
+  CHECK(config == std::vector<std::uint8_t>{0x52, 0x06, 0x1a, 0x04, 0x28, 0x01, 0x38, 0x01});
+
+  // Grappler: cheap startup for a cold model, fusion and bf16 for a hot one.
+  REQUIRE(tf_utils::SessionConfigBuilder()
+              .SetAutoMixedPrecisionOnednnBfloat16(tf_utils::RewriterToggle::On)
+              .SetMetaOptimizerTimeout(std::chrono::milliseconds(100))
+              .SetRemapping(tf_utils::RewriterToggle::On)
+              .SetMetaOptimizerIterations(tf_utils::MetaOptimizerIterations::One)
+              .SetArithmeticOptimization(tf_utils::RewriterToggle::Off)
+              .SetConstantFolding(tf_utils::RewriterToggle::Off)
+              .SetLayoutOptimizer(tf_utils::RewriterToggle::Aggressive)
+              .Build(config, status) == TF_OK);
+  CHECK(config == std::vector<std::uint8_t>{0x52, 0x12, 0x52, 0x10,
+                                            0x08, 0x03, // layout_optimizer
+                                            0x18, 0x02, // constant_folding
+                                            0x38, 0x02, // arithmetic_optimization
+                                            0x60, 0x01, // meta_optimizer_iterations
+                                            0x70, 0x01, // remapping
+                                            0xa0, 0x01, 0x64, // meta_optimizer_timeout_ms
+                                            0xf8, 0x01, 0x01}); // auto_mixed_precision_onednn_bfloat16
+
+  REQUIRE(tf_utils::SessionConfigBuilder()
+              .AddSessionInterOpThreadPool({2, ""})
+              .UseSharedInterOpThreadPool("shared", 8)
+              .Build(config, status) == TF_OK);
+  CHECK(config == std::vector<std::uint8_t>{0x48, 0x00, 0x62, 0x0a, 0x08, 0x08, 0x12, 0x06, 's', 'h', 'a', 'r', 'e', 'd'});
+
+  auto options = tf_utils::SessionConfigBuilder().SetDeviceCount("CPU", 1).SetMinGraphNodes(-1).CreateSessionOptions(status);
+  SCOPE_EXIT{ tf_utils::DeleteSessionOptions(options); };
+  CHECK(options != nullptr);
+  CHECK(TF_GetCode(status) == TF_OK);
+
+  CHECK(tf_utils::SessionConfigBuilder().SetDeviceCount("CPU", -1).Build(config, status) == TF_INVALID_ARGUMENT);
+  CHECK(tf_utils::SessionConfigBuilder().AddSessionInterOpThreadPool({-1, ""}).Build(config, status) == TF_INVALID_ARGUMENT);
+  CHECK(tf_utils::SessionConfigBuilder().SetPerProcessGpuMemoryFraction(2.0).CreateSessionOptions(status) == nullptr);
+  CHECK(TF_GetCode(status) == TF_INVALID_ARGUMENT);
+}
+
+TEST_CASE("GraphDeviceScope pins branches to CPU devices") {
+  auto status = TF_NewStatus();
+  SCOPE_EXIT{ TF_DeleteStatus(status); };
+
+  auto graph = TF_NewGraph();
+  SCOPE_EXIT{ TF_DeleteGraph(graph); };
+
+  CHECK(tf_utils::CpuDeviceName(1) == "/device:CPU:1");
+
+  auto input = AddPlaceholder(graph, "input", TF_FLOAT, status);
+  REQUIRE(TF_GetCode(status) == TF_OK);
+  auto scale = AddFloatConst(graph, "scale", 2.0f, status);
+  REQUIRE(TF_GetCode(status) == TF_OK);
+
+  std::vector<TF_Output> outputs;
+  for (std::int32_t branch = 0; branch < 2; ++branch) {
+    const tf_utils::GraphDeviceScope scope(graph, tf_utils::CpuDeviceName(branch));
+    const auto name = "branch_" + std::to_string(branch);
+    auto desc = scope.NewOperation("Mul", name.c_str());
+    TF_SetAttrType(desc, "T", TF_FLOAT);
+    TF_AddInput(desc, TF_Output{input, 0});
+    TF_AddInput(desc, TF_Output{scale, 0});
+    auto mul = TF_FinishOperation(desc, status);
+    REQUIRE(TF_GetCode(status) == TF_OK);
+    CHECK(std::string(TF_OperationDevice(mul)) == scope.device());
+    outputs.push_back(TF_Output{mul, 0});
+  }
+
+  auto unpinned = tf_utils::GraphDeviceScope(graph, "").NewOperation("Identity", "unpinned");
+  TF_SetAttrType(unpinned, "T", TF_FLOAT);
+  TF_AddInput(unpinned, TF_Output{input, 0});
+  auto identity = TF_FinishOperation(unpinned, status);
+  REQUIRE(TF_GetCode(status) == TF_OK);
+  CHECK(std::string(TF_OperationDevice(identity)).empty());
+
+  auto options = tf_utils::SessionConfigBuilder().SetDeviceCount("CPU", 2).CreateSessionOptions(status);
+  SCOPE_EXIT{ tf_utils::DeleteSessionOptions(options); };
+  REQUIRE(options != nullptr);
+  auto session = tf_utils::CreateSession(graph, options, status);
+  SCOPE_EXIT{ tf_utils::DeleteSession(session); };
+  REQUIRE(session != nullptr);
+
+  const std::vector<TF_Tensor*> input_tensors = {tf_utils::CreateTensor(TF_FLOAT, std::vector<std::int64_t>{1}, std::vector<float>{3.0f})};
+  SCOPE_EXIT{ tf_utils::DeleteTensors(input_tensors); };
+  std::vector<TF_Tensor*> output_tensors = {nullptr, nullptr};
+  SCOPE_EXIT{ tf_utils::DeleteTensors(output_tensors); };
+  REQUIRE(tf_utils::RunSession(session, {TF_Output{input, 0}}, input_tensors, outputs, output_tensors, status) == TF_OK);
+  CHECK(tf_utils::GetTensorData<float>(output_tensors[0]) == std::vector<float>{6.0f});
+  CHECK(tf_utils::GetTensorData<float>(output_tensors[1]) == std::vector<float>{6.0f});
+}
+
 TEST_CASE("CreateEmptyTensor supports scalar tensors") {
   const float value = 3.5f;
 
@@ -556,6 +777,785 @@ TEST_CASE("RunSession target overload rejects missing target array") {
   CHECK(TF_GetCode(status) == TF_INVALID_ARGUMENT);
 }
 
+TEST_CASE("SessionPool hands out each session to one caller at a time") {
+  auto status = TF_NewStatus();
+  SCOPE_EXIT{ TF_DeleteStatus(status); };
+
+  auto graph = TF_NewGraph();
+  SCOPE_EXIT{ TF_DeleteGraph(graph); };
+
+  CHECK(tf_utils::CreateSessionPool(nullptr, 2, nullptr, status) == nullptr);
+  CHECK(TF_GetCode(status) == TF_INVALID_ARGUMENT);
+  TF_SetStatus(status, TF_OK, "");
+  CHECK(tf_utils::CreateSessionPool(graph, 0, nullptr, status) == nullptr);
+  CHECK(TF_GetCode(status) == TF_INVALID_ARGUMENT);
+  TF_SetStatus(status, TF_OK, "");
+
+  auto pool = tf_utils::CreateSessionPool(graph, 2, nullptr, status);
+  SCOPE_EXIT{ tf_utils::DeleteSessionPool(pool); };
+  REQUIRE(pool != nullptr);
+  REQUIRE(pool->size() == 2);
+
+  {
+    auto first = pool->TryAcquire();
+    auto second = pool->Acquire();
+    REQUIRE(first);
+    REQUIRE(second);
+    CHECK(first.session() != nullptr);
+    CHECK(first.session() != second.session());
+    CHECK_FALSE(pool->TryAcquire());
+    CHECK_FALSE(pool->Acquire(std::chrono::milliseconds(1)));
+
+    first.Release();
+    CHECK_FALSE(first);
+    CHECK(pool->TryAcquire());
+  }
+
+  constexpr int thread_count = 8;
+  constexpr int iterations = 1000;
+  std::array<std::atomic<int>, 2> owners = {};
+  std::atomic<bool> shared_checkout{false};
+  std::vector<std::thread> threads;
+  for (int t = 0; t < thread_count; ++t) {
+    threads.emplace_back([&] {
+      for (int i = 0; i < iterations; ++i) {
+        auto lease = pool->Acquire();
+        if (owners[lease.index()].fetch_add(1) != 0) {
+          shared_checkout = true;
+        }
+        owners[lease.index()].fetch_sub(1);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  CHECK_FALSE(shared_checkout.load());
+  const auto usage = pool->Usage();
+  REQUIRE(usage.size() == 2);
+  CHECK(usage[0].checkouts + usage[1].checkouts == 3 + thread_count * iterations);
+  CHECK(usage[0].utilization >= 0.0);
+  CHECK(usage[0].utilization <= 1.0);
+}
+
+TEST_CASE("SharedSessionRunner runs one session from many threads") {
+  auto status = TF_NewStatus();
+  SCOPE_EXIT{ TF_DeleteStatus(status); };
+
+  auto graph = TF_NewGraph();
+  SCOPE_EXIT{ TF_DeleteGraph(graph); };
+
+  auto input = AddPlaceholder(graph, "input", TF_FLOAT, status);
+  REQUIRE(TF_GetCode(status) == TF_OK);
+  auto output = AddIdentity(graph, "output", TF_Output{input, 0}, TF_FLOAT, status);
+  REQUIRE(TF_GetCode(status) == TF_OK);
+
+  auto session = tf_utils::CreateSession(graph, status);
+  SCOPE_EXIT{ tf_utils::DeleteSession(session); };
+  REQUIRE(session != nullptr);
+
+  const tf_utils::SharedSessionRunner invalid_runner(nullptr, {}, {});
+  std::vector<TF_Tensor*> no_tensors;
+  CHECK(invalid_runner.Run(no_tensors, no_tensors) == TF_INVALID_ARGUMENT);
+  CHECK(std::string(tf_utils::SharedSessionRunner::LastMessage()).size() > 0);
+
+  const tf_utils::SharedSessionRunner runner(session, {TF_Output{input, 0}}, {TF_Output{output, 0}});
+  REQUIRE(runner.num_inputs() == 1);
+  REQUIRE(runner.num_outputs() == 1);
+
+  std::atomic<int> failures{0};
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&, t] {
+      const std::vector<float> values = {static_cast<float>(t)};
+      std::vector<TF_Tensor*> input_tensors = {tf_utils::CreateTensor(TF_FLOAT, std::vector<std::int64_t>{1}, values)};
+      SCOPE_EXIT{ tf_utils::DeleteTensors(input_tensors); };
+      std::vector<TF_Tensor*> output_tensors;
+      for (int i = 0; i < 50; ++i) {
+        if (runner.Run(input_tensors, output_tensors) != TF_OK ||
+            tf_utils::GetTensorData<float>(output_tensors[0]) != values) {
+          ++failures;
+        }
+        tf_utils::DeleteTensors(output_tensors);
+
+        if (runner.Run(input_tensors) != TF_OK ||
+            tf_utils::GetTensorData<float>(tf_utils::SharedSessionRunner::ScratchOutput(0)) != values) {
+          ++failures;
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  CHECK(failures.load() == 0);
+
+  const std::vector<TF_Tensor*> input_tensors = {tf_utils::CreateTensor(TF_FLOAT, std::vector<std::int64_t>{1}, std::vector<float>{7.0f})};
+  SCOPE_EXIT{ tf_utils::DeleteTensors(input_tensors); };
+  REQUIRE(runner.Run(input_tensors, status) == TF_OK);
+  auto kept = tf_utils::SharedSessionRunner::ReleaseScratchOutput(0);
+  SCOPE_EXIT{ tf_utils::DeleteTensor(kept); };
+  CHECK(tf_utils::SharedSessionRunner::ScratchOutput(0) == nullptr);
+  REQUIRE(runner.Run(input_tensors, status) == TF_OK);
+  CHECK(tf_utils::GetTensorData<float>(kept) == std::vector<float>{7.0f});
+  CHECK(tf_utils::SharedSessionRunner::ScratchOutput(1) == nullptr);
+  CHECK(runner.Run(no_tensors, status) == TF_INVALID_ARGUMENT);
+  REQUIRE(tf_utils::SharedSessionRunner::ScratchOutput(0) != nullptr);
+
+  // The previous scratch outputs stay alive until the run fed with them has finished.
+  REQUIRE(runner.Run({tf_utils::SharedSessionRunner::ScratchOutput(0)}, status) == TF_OK);
+  CHECK(tf_utils::GetTensorData<float>(tf_utils::SharedSessionRunner::ScratchOutput(0)) == std::vector<float>{7.0f});
+}
+
+TEST_CASE("DecodeStepStats reads node timings from RunMetadata") {
+  const std::vector<std::uint8_t> run_metadata = {
+    0x0a, 0x2a, // RunMetadata.step_stats
+      0x0a, 0x28, // StepStats.dev_stats
+        0x0a, 0x06, '/', 'c', 'p', 'u', ':', '0', // DeviceStepStats.device
+        0x12, 0x10, // DeviceStepStats.node_stats
+          0x0a, 0x03, 'a', 'd', 'd', // node_name
+          0x10, 0xe8, 0x07, // all_start_micros = 1000
+          0x18, 0x02, // op_start_rel_micros = 2
+          0x20, 0x07, // op_end_rel_micros = 7
+          0x28, 0x09, // all_end_rel_micros = 9
+          0x50, 0x03, // thread_id = 3
+        0x12, 0x0c, // DeviceStepStats.node_stats
+          0x0a, 0x03, 'm', 'u', 'l', // node_name
+          0x68, 0x80, 0x89, 0x7a, // all_start_nanos = 2000000
+          0x78, 0x88, 0x27, // op_end_rel_nanos = 5000
+  };
+
+  std::vector<tf_utils::NodeStepStats> nodes;
+  REQUIRE(tf_utils::DecodeStepStats(run_metadata, nodes));
+  REQUIRE(nodes.size() == 2);
+  CHECK(nodes[0].device == "/cpu:0");
+  CHECK(nodes[0].node_name == "add");
+  CHECK(nodes[0].all_start_micros == 1000);
+  CHECK(nodes[0].op_start_rel_micros == 2);
+  CHECK(nodes[0].op_end_rel_micros == 7);
+  CHECK(nodes[0].all_end_rel_micros == 9);
+  CHECK(nodes[0].thread_id == 3);
+  CHECK(nodes[1].device == "/cpu:0");
+  CHECK(nodes[1].node_name == "mul");
+  CHECK(nodes[1].all_start_micros == 2000);
+  CHECK(nodes[1].op_end_rel_micros == 5);
+
+  auto truncated = run_metadata;
+  truncated.pop_back();
+  CHECK_FALSE(tf_utils::DecodeStepStats(truncated, nodes));
+  CHECK(tf_utils::DecodeStepStats({}, nodes));
+  CHECK(nodes.empty());
+}
+
+TEST_CASE("RunSession with a trace level returns RunMetadata") {
+  auto status = TF_NewStatus();
+  SCOPE_EXIT{ TF_DeleteStatus(status); };
+
+  auto graph = TF_NewGraph();
+  SCOPE_EXIT{ TF_DeleteGraph(graph); };
+
+  auto input = AddPlaceholder(graph, "input", TF_FLOAT, status);
+  REQUIRE(TF_GetCode(status) == TF_OK);
+  auto output = AddIdentity(graph, "output", TF_Output{input, 0}, TF_FLOAT, status);
+  REQUIRE(TF_GetCode(status) == TF_OK);
+
+  auto session = tf_utils::CreateSession(graph, status);
+  SCOPE_EXIT{ tf_utils::DeleteSession(session); };
+  REQUIRE(session != nullptr);
+
+  const std::vector<TF_Tensor*> input_tensors = {tf_utils::CreateTensor(TF_FLOAT, std::vector<std::int64_t>{1}, std::vector<float>{1.0f})};
+  SCOPE_EXIT{ tf_utils::DeleteTensors(input_tensors); };
+  std::vector<TF_Tensor*> output_tensors = {nullptr};
+  SCOPE_EXIT{ tf_utils::DeleteTensors(output_tensors); };
+
+  std::vector<std::uint8_t> run_metadata;
+  REQUIRE(tf_utils::RunSession(session, {TF_Output{input, 0}}, input_tensors, {TF_Output{output, 0}}, output_tensors,
+                               tf_utils::TraceLevel::FullTrace, run_metadata, status) == TF_OK);
+  CHECK_FALSE(run_metadata.empty());
+  std::vector<tf_utils::NodeStepStats> nodes;
+  CHECK(tf_utils::DecodeStepStats(run_metadata, nodes));
+}
+
+TEST_CASE("RunSession with a timeout returns TF_DEADLINE_EXCEEDED for a blocked run") {
+  auto status = TF_NewStatus();
+  SCOPE_EXIT{ TF_DeleteStatus(status); };
+
+  auto graph = TF_NewGraph();
+  SCOPE_EXIT{ TF_DeleteGraph(graph); };
+
+  auto input = AddPlaceholder(graph, "input", TF_FLOAT, status);
+  REQUIRE(TF_GetCode(status) == TF_OK);
+  auto output = AddIdentity(graph, "output", TF_Output{input, 0}, TF_FLOAT, status);
+  REQUIRE(TF_GetCode(status) == TF_OK);
+
+  // Dequeuing from an empty queue blocks until the run deadline.
+  const TF_DataType component_types[] = {TF_FLOAT};
+  auto queue_desc = TF_NewOperation(graph, "FIFOQueueV2", "queue");
+  TF_SetAttrTypeList(queue_desc, "component_types", component_types, 1);
+  auto queue = TF_FinishOperation(queue_desc, status);
+  REQUIRE(TF_GetCode(status) == TF_OK);
+  auto dequeue_desc = TF_NewOperation(graph, "QueueDequeueV2", "dequeue");
+  TF_AddInput(dequeue_desc, TF_Output{queue, 0});
+  TF_SetAttrTypeList(dequeue_desc, "component_types", component_types, 1);
+  auto dequeue = TF_FinishOperation(dequeue_desc, status);
+  REQUIRE(TF_GetCode(status) == TF_OK);
+
+  auto session = tf_utils::CreateSession(graph, status);
+  SCOPE_EXIT{ tf_utils::DeleteSession(session); };
+  REQUIRE(session != nullptr);
+
+  const std::vector<TF_Tensor*> input_tensors = {tf_utils::CreateTensor(TF_FLOAT, std::vector<std::int64_t>{1}, std::vector<float>{1.0f})};
+  SCOPE_EXIT{ tf_utils::DeleteTensors(input_tensors); };
+  std::vector<TF_Tensor*> output_tensors = {nullptr};
+  SCOPE_EXIT{ tf_utils::DeleteTensors(output_tensors); };
+
+  CHECK(tf_utils::RunSession(session, {TF_Output{input, 0}}, input_tensors, {TF_Output{output, 0}}, output_tensors,
+                             std::chrono::milliseconds(0), status) == TF_INVALID_ARGUMENT);
+  REQUIRE(tf_utils::RunSession(session, {TF_Output{input, 0}}, input_tensors, {TF_Output{output, 0}}, output_tensors,
+                               std::chrono::seconds(10), status) == TF_OK);
+  CHECK(tf_utils::GetTensorData<float>(output_tensors[0]) == std::vector<float>{1.0f});
+
+  std::vector<TF_Tensor*> dequeued = {nullptr};
+  SCOPE_EXIT{ tf_utils::DeleteTensors(dequeued); };
+  CHECK(tf_utils::RunSession(session, {}, {}, {TF_Output{dequeue, 0}}, dequeued,
+                             std::chrono::milliseconds(50), status) == TF_DEADLINE_EXCEEDED);
+  CHECK(TF_GetCode(status) == TF_DEADLINE_EXCEEDED);
+}
+
+TEST_CASE("WarmupSession runs synthesized inputs for every batch size") {
+  auto status = TF_NewStatus();
+  SCOPE_EXIT{ TF_DeleteStatus(status); };
+
+  auto graph = TF_NewGraph();
+  SCOPE_EXIT{ TF_DeleteGraph(graph); };
+
+  const std::int64_t input_dims[] = {-1, 3};
+  auto input_desc = TF_NewOperation(graph, "Placeholder", "input");
+  TF_SetAttrType(input_desc, "dtype", TF_FLOAT);
+  TF_SetAttrShape(input_desc, "shape", input_dims, 2);
+  auto input = TF_FinishOperation(input_desc, status);
+  REQUIRE(TF_GetCode(status) == TF_OK);
+  auto output = AddIdentity(graph, "output", TF_Output{input, 0}, TF_FLOAT, status);
+  REQUIRE(TF_GetCode(status) == TF_OK);
+
+  auto session = tf_utils::CreateSession(graph, status);
+  SCOPE_EXIT{ tf_utils::DeleteSession(session); };
+  REQUIRE(session != nullptr);
+
+  const std::vector<TF_Output> inputs = {TF_Output{input, 0}};
+  const std::vector<TF_Output> outputs = {TF_Output{output, 0}};
+  std::vector<tf_utils::WarmupPass> passes;
+  CHECK(tf_utils::WarmupSession(session, graph, inputs, outputs, {}, 1, passes, tf_utils::WarmupFill::Zeros, status) == TF_INVALID_ARGUMENT);
+  CHECK(tf_utils::WarmupSession(session, graph, inputs, outputs, {0}, 1, passes, tf_utils::WarmupFill::Zeros, status) == TF_INVALID_ARGUMENT);
+
+  REQUIRE(tf_utils::WarmupSession(session, graph, inputs, outputs, {1, 8}, 3, passes, tf_utils::WarmupFill::Random, status) == TF_OK);
+  REQUIRE(passes.size() == 6);
+  for (std::size_t i = 0; i < passes.size(); ++i) {
+    CHECK(passes[i].batch_size == (i < 3 ? 1 : 8));
+    CHECK(passes[i].iteration == i % 3);
+    CHECK(passes[i].code == TF_OK);
+    CHECK(passes[i].duration.count() >= 0);
+  }
+
+  // A fetch that depends on an unfed placeholder fails the first pass and stops the warmup.
+  auto unfed = AddPlaceholder(graph, "unfed", TF_FLOAT, status);
+  REQUIRE(TF_GetCode(status) == TF_OK);
+  auto unfed_output = AddIdentity(graph, "unfed_output", TF_Output{unfed, 0}, TF_FLOAT, status);
+  REQUIRE(TF_GetCode(status) == TF_OK);
+
+  // An unshaped placeholder has unknown rank, so there is no shape to synthesize and nothing runs.
+  CHECK(tf_utils::WarmupSession(session, graph, {TF_Output{unfed, 0}}, {TF_Output{unfed_output, 0}}, {2}, 1, passes, tf_utils::WarmupFill::Zeros, status) == TF_INVALID_ARGUMENT);
+  CHECK(passes.empty());
+  CHECK(tf_utils::WarmupSession(session, graph, inputs, {TF_Output{unfed_output, 0}}, {2}, 2, passes) != TF_OK);
+  REQUIRE(passes.size() == 1);
+  CHECK(passes[0].code != TF_OK);
+}
+
+TEST_CASE("PreparedRun resolves names once and reuses its output array") {
+  auto status = TF_NewStatus();
+  SCOPE_EXIT{ TF_DeleteStatus(status); };
+
+  auto graph = TF_NewGraph();
+  SCOPE_EXIT{ TF_DeleteGraph(graph); };
+
+  auto input = AddPlaceholder(graph, "input", TF_FLOAT, status);
+  REQUIRE(TF_GetCode(status) == TF_OK);
+  AddIdentity(graph, "output", TF_Output{input, 0}, TF_FLOAT, status);
+  REQUIRE(TF_GetCode(status) == TF_OK);
+
+  auto session = tf_utils::CreateSession(graph, status);
+  SCOPE_EXIT{ tf_utils::DeleteSession(session); };
+  REQUIRE(session != nullptr);
+
+  CHECK(tf_utils::CreatePreparedRun(session, graph, {"input"}, {"missing"}, {}, status) == nullptr);
+  CHECK(TF_GetCode(status) == TF_INVALID_ARGUMENT);
+  TF_SetStatus(status, TF_OK, "");
+  CHECK(tf_utils::CreatePreparedRun(session, graph, {"input"}, {"output:1"}, {}, status) == nullptr);
+  CHECK(TF_GetCode(status) == TF_INVALID_ARGUMENT);
+  TF_SetStatus(status, TF_OK, "");
+
+  auto run = tf_utils::CreatePreparedRun(session, graph, {"input"}, {"output:0"}, {}, status);
+  SCOPE_EXIT{ tf_utils::DeletePreparedRun(run); };
+  REQUIRE(run != nullptr);
+  REQUIRE(run->num_inputs() == 1);
+  REQUIRE(run->num_outputs() == 1);
+
+  CHECK(run->Run(std::vector<TF_Tensor*>{}) == TF_INVALID_ARGUMENT);
+  CHECK(std::string(run->message()).size() > 0);
+
+  for (int i = 0; i < 3; ++i) {
+    const std::vector<float> values = {static_cast<float>(i), 1.0f};
+    auto input_tensor = tf_utils::CreateTensor(TF_FLOAT, std::vector<std::int64_t>{2}, values);
+    SCOPE_EXIT{ tf_utils::DeleteTensor(input_tensor); };
+
+    REQUIRE(run->Run(&input_tensor) == TF_OK);
+    CHECK(tf_utils::GetTensorData<float>(run->output(0)) == values);
+  }
+  CHECK(run->output(1) == nullptr);
+
+  // A recurrent loop feeds the previous output back; it is deleted only after the run that reads it.
+  CHECK(run->Run(std::vector<TF_Tensor*>{}) == TF_INVALID_ARGUMENT);
+  REQUIRE(run->output(0) != nullptr);
+  for (int i = 0; i < 2; ++i) {
+    auto previous = run->output(0);
+    REQUIRE(run->Run(&previous) == TF_OK);
+    CHECK(run->output(0) != previous);
+    CHECK(tf_utils::GetTensorData<float>(run->output(0)) == std::vector<float>{2.0f, 1.0f});
+  }
+
+  auto released = run->ReleaseOutput(0);
+  SCOPE_EXIT{ tf_utils::DeleteTensor(released); };
+  CHECK(released != nullptr);
+  CHECK(run->output(0) == nullptr);
+}
+
+TEST_CASE("PartialRun feeds inputs and fetches outputs across calls") {
+  auto status = TF_NewStatus();
+  SCOPE_EXIT{ TF_DeleteStatus(status); };
+
+  auto graph = TF_NewGraph();
+  SCOPE_EXIT{ TF_DeleteGraph(graph); };
+
+  auto image = AddPlaceholder(graph, "image", TF_FLOAT, status);
+  REQUIRE(TF_GetCode(status) == TF_OK);
+  auto scale = AddPlaceholder(graph, "scale", TF_FLOAT, status);
+  REQUIRE(TF_GetCode(status) == TF_OK);
+  auto features = AddIdentity(graph, "features", TF_Output{image, 0}, TF_FLOAT, status);
+  REQUIRE(TF_GetCode(status) == TF_OK);
+  auto scaled = AddMul(graph, "scaled", TF_Output{features, 0}, TF_Output{scale, 0}, status);
+  REQUIRE(TF_GetCode(status) == TF_OK);
+
+  auto session = tf_utils::CreateSession(graph, status);
+  SCOPE_EXIT{ tf_utils::DeleteSession(session); };
+  REQUIRE(session != nullptr);
+
+  CHECK_FALSE(tf_utils::SetupPartialRun(nullptr, {}, {}, {}, status));
+  CHECK(TF_GetCode(status) == TF_INVALID_ARGUMENT);
+  TF_SetStatus(status, TF_OK, "");
+
+  auto run = tf_utils::SetupPartialRun(session,
+                                       {TF_Output{image, 0}, TF_Output{scale, 0}},
+                                       {TF_Output{features, 0}, TF_Output{scaled, 0}},
+                                       {}, status);
+  REQUIRE(run);
+
+  auto image_tensor = tf_utils::CreateTensor(TF_FLOAT, std::vector<std::int64_t>{2}, std::vector<float>{1.0f, 2.0f});
+  SCOPE_EXIT{ tf_utils::DeleteTensor(image_tensor); };
+  std::vector<TF_Tensor*> early_outputs = {nullptr};
+  SCOPE_EXIT{ tf_utils::DeleteTensors(early_outputs); };
+  REQUIRE(run.Run({TF_Output{image, 0}}, {image_tensor}, {TF_Output{features, 0}}, early_outputs, status) == TF_OK);
+  CHECK(tf_utils::GetTensorData<float>(early_outputs[0]) == std::vector<float>{1.0f, 2.0f});
+
+  auto scale_tensor = tf_utils::CreateTensor(TF_FLOAT, std::vector<std::int64_t>{}, std::vector<float>{3.0f});
+  SCOPE_EXIT{ tf_utils::DeleteTensor(scale_tensor); };
+  std::vector<TF_Tensor*> late_outputs = {nullptr};
+  SCOPE_EXIT{ tf_utils::DeleteTensors(late_outputs); };
+  REQUIRE(run.Run({TF_Output{scale, 0}}, {scale_tensor}, {TF_Output{scaled, 0}}, late_outputs, status) == TF_OK);
+  CHECK(tf_utils::GetTensorData<float>(late_outputs[0]) == std::vector<float>{3.0f, 6.0f});
+
+  auto moved = std::move(run);
+  CHECK(moved);
+  CHECK_FALSE(run);
+  moved.Reset();
+  std::vector<TF_Tensor*> no_outputs;
+  CHECK(moved.Run({}, {}, {}, no_outputs, status) == TF_INVALID_ARGUMENT);
+}
+
+TEST_CASE("Run hooks wrap every session run until removed") {
+  auto status = TF_NewStatus();
+  SCOPE_EXIT{ TF_DeleteStatus(status); };
+
+  auto graph = TF_NewGraph();
+  SCOPE_EXIT{ TF_DeleteGraph(graph); };
+
+  auto input = AddPlaceholder(graph, "input", TF_FLOAT, status);
+  REQUIRE(TF_GetCode(status) == TF_OK);
+  auto output = AddIdentity(graph, "output", TF_Output{input, 0}, TF_FLOAT, status);
+  REQUIRE(TF_GetCode(status) == TF_OK);
+
+  auto session = tf_utils::CreateSession(graph, status);
+  SCOPE_EXIT{ tf_utils::DeleteSession(session); };
+  REQUIRE(session != nullptr);
+
+  std::vector<std::string> calls;
+  std::vector<TF_Code> codes;
+  const auto outer = tf_utils::AddRunHooks(
+      [&](const tf_utils::RunHookContext& context) {
+        calls.push_back("outer before");
+        CHECK(context.session == session);
+        CHECK(context.output_tensors == nullptr);
+        for (std::size_t i = 0; i < context.num_inputs; ++i) {
+          CHECK(std::string(TF_OperationName(context.inputs[i].oper)) == "input");
+        }
+      },
+      [&](const tf_utils::RunHookContext& context) {
+        calls.push_back("outer after");
+        codes.push_back(context.code);
+        CHECK(context.duration.count() >= 0);
+        if (context.code == TF_OK) {
+          CHECK(context.num_outputs == 1);
+          CHECK(std::string(TF_OperationName(context.outputs[0].oper)) == "output");
+          CHECK(tf_utils::GetTensorData<float>(context.output_tensors[0]) == std::vector<float>{5.0f});
+        } else {
+          CHECK(std::string(context.message).size() > 0);
+        }
+      });
+  const auto inner = tf_utils::AddRunHooks(
+      [&](const tf_utils::RunHookContext&) { calls.push_back("inner before"); },
+      nullptr);
+  SCOPE_EXIT{
+    tf_utils::RemoveRunHooks(outer);
+    tf_utils::RemoveRunHooks(inner);
+  };
+
+  const std::vector<TF_Tensor*> input_tensors = {tf_utils::CreateTensor(TF_FLOAT, std::vector<std::int64_t>{1}, std::vector<float>{5.0f})};
+  SCOPE_EXIT{ tf_utils::DeleteTensors(input_tensors); };
+  std::vector<TF_Tensor*> output_tensors = {nullptr};
+  SCOPE_EXIT{ tf_utils::DeleteTensors(output_tensors); };
+  REQUIRE(tf_utils::RunSession(session, {TF_Output{input, 0}}, input_tensors, {TF_Output{output, 0}}, output_tensors, status) == TF_OK);
+  CHECK(calls == std::vector<std::string>{"outer before", "inner before", "outer after"});
+
+  tf_utils::SharedSessionRunner runner(session, {TF_Output{input, 0}}, {TF_Output{output, 0}});
+  std::vector<TF_Tensor*> shared_outputs;
+  SCOPE_EXIT{ tf_utils::DeleteTensors(shared_outputs); };
+  REQUIRE(runner.Run(input_tensors, shared_outputs, status) == TF_OK);
+
+  auto run = tf_utils::CreatePreparedRun(session, graph, {"input"}, {"output"}, {}, status);
+  SCOPE_EXIT{ tf_utils::DeletePreparedRun(run); };
+  REQUIRE(run != nullptr);
+  REQUIRE(run->Run(input_tensors, status) == TF_OK);
+
+  std::vector<TF_Tensor*> unfed_outputs = {nullptr};
+  CHECK(tf_utils::RunSession(session, {}, {}, {TF_Output{output, 0}}, unfed_outputs, status) != TF_OK); // The placeholder is not fed.
+  CHECK(codes.size() == 4);
+  CHECK(codes.back() != TF_OK);
+
+  CHECK(tf_utils::RemoveRunHooks(outer));
+  CHECK(tf_utils::RemoveRunHooks(inner));
+  CHECK_FALSE(tf_utils::RemoveRunHooks(inner));
+  calls.clear();
+  REQUIRE(run->Run(input_tensors, status) == TF_OK);
+  CHECK(calls.empty());
+}
+
+TEST_CASE("RunSessionAsync completes runs on the executor and rejects work when the queue is full") {
+  auto status = TF_NewStatus();
+  SCOPE_EXIT{ TF_DeleteStatus(status); };
+
+  auto graph = TF_NewGraph();
+  SCOPE_EXIT{ TF_DeleteGraph(graph); };
+
+  auto input = AddPlaceholder(graph, "input", TF_FLOAT, status);
+  REQUIRE(TF_GetCode(status) == TF_OK);
+  auto output = AddIdentity(graph, "output", TF_Output{input, 0}, TF_FLOAT, status);
+  REQUIRE(TF_GetCode(status) == TF_OK);
+
+  auto session = tf_utils::CreateSession(graph, status);
+  SCOPE_EXIT{ tf_utils::DeleteSession(session); };
+  REQUIRE(session != nullptr);
+
+  CHECK(tf_utils::CreateSessionExecutor(0, 1, status) == nullptr);
+  CHECK(TF_GetCode(status) == TF_INVALID_ARGUMENT);
+  TF_SetStatus(status, TF_OK, "");
+
+  auto executor = tf_utils::CreateSessionExecutor(1, 1, status);
+  SCOPE_EXIT{ tf_utils::DeleteSessionExecutor(executor); };
+  REQUIRE(executor != nullptr);
+
+  const std::vector<TF_Output> inputs = {TF_Output{input, 0}};
+  const std::vector<TF_Output> outputs = {TF_Output{output, 0}};
+  const std::vector<float> values = {1.0f, 2.0f};
+  const std::vector<TF_Tensor*> input_tensors = {tf_utils::CreateTensor(TF_FLOAT, std::vector<std::int64_t>{2}, values)};
+  SCOPE_EXIT{ tf_utils::DeleteTensors(input_tensors); };
+
+  auto future = tf_utils::RunSessionAsync(executor, session, inputs, input_tensors, outputs, status);
+  REQUIRE(future.valid());
+  auto result = future.get();
+  REQUIRE(result.code == TF_OK);
+  REQUIRE(result.output_tensors.size() == 1);
+  CHECK(tf_utils::GetTensorData<float>(result.output_tensors[0]) == values);
+  tf_utils::DeleteTensors(result.output_tensors);
+
+  auto failed = tf_utils::RunSessionAsync(executor, session, {}, {}, outputs, status).get();
+  CHECK(failed.code != TF_OK);
+  CHECK_FALSE(failed.message.empty());
+  CHECK(failed.output_tensors.empty());
+
+  // Hold the only worker, fill the one queue slot, and the next run has to be refused.
+  std::promise<void> release_worker;
+  std::promise<void> worker_busy;
+  REQUIRE(executor->TrySubmit([&] {
+    worker_busy.set_value();
+    release_worker.get_future().wait();
+  }));
+  worker_busy.get_future().wait();
+
+  std::promise<TF_Code> callback_code;
+  REQUIRE(tf_utils::RunSessionAsync(executor, session, inputs, input_tensors, outputs,
+                                    [&](tf_utils::RunResult queued) {
+                                      tf_utils::DeleteTensors(queued.output_tensors);
+                                      callback_code.set_value(queued.code);
+                                    },
+                                    status) == TF_OK);
+  CHECK(executor->queue_depth() == 1);
+  CHECK(tf_utils::RunSessionAsync(executor, session, inputs, input_tensors, outputs,
+                                  [](tf_utils::RunResult) {},
+                                  status) == TF_RESOURCE_EXHAUSTED);
+  CHECK(TF_GetCode(status) == TF_RESOURCE_EXHAUSTED);
+  CHECK_FALSE(tf_utils::RunSessionAsync(executor, session, inputs, input_tensors, outputs).valid());
+
+  release_worker.set_value();
+  CHECK(callback_code.get_future().get() == TF_OK);
+}
+
+TEST_CASE("CPU partitions pin TensorFlow pools and callers to separate CPUs") {
+  auto status = TF_NewStatus();
+  SCOPE_EXIT{ TF_DeleteStatus(status); };
+
+  CHECK(tf_utils::ValidateCpuPartition({}, status) == TF_INVALID_ARGUMENT);
+  CHECK(tf_utils::ValidateCpuPartition({{0}, {}, {0}}, status) == TF_INVALID_ARGUMENT);
+  CHECK(tf_utils::ValidateCpuPartition({{}, {}, {-1}}, status) == TF_INVALID_ARGUMENT);
+  CHECK(tf_utils::PinCurrentThreadToCpus({}, status) == TF_INVALID_ARGUMENT);
+#if defined(__linux__)
+  CHECK(tf_utils::PinCurrentThreadToCpus({1 << 20}, status) == TF_INVALID_ARGUMENT);
+#endif
+
+  const auto cpus = static_cast<std::size_t>(std::max(1u, std::thread::hardware_concurrency()));
+  CHECK(tf_utils::PartitionAvailableCpus(cpus, 0).tensorflow_cpus.empty());
+  auto partition = tf_utils::PartitionAvailableCpus(0, 0);
+  REQUIRE(!partition.tensorflow_cpus.empty());
+  CHECK(partition.preprocessing_cpus.empty());
+  CHECK(tf_utils::ValidateCpuPartition(partition, status) == TF_OK);
+
+  auto graph = TF_NewGraph();
+  SCOPE_EXIT{ TF_DeleteGraph(graph); };
+  auto input = AddPlaceholder(graph, "input", TF_FLOAT, status);
+  REQUIRE(TF_GetCode(status) == TF_OK);
+  auto output = AddIdentity(graph, "output", TF_Output{input, 0}, TF_FLOAT, status);
+  REQUIRE(TF_GetCode(status) == TF_OK);
+
+  CHECK(tf_utils::CreatePartitionedSession(nullptr, partition, {}, status) == nullptr);
+  SetEnvironmentVariable("TF_OVERRIDE_GLOBAL_THREADPOOL", nullptr);
+  CHECK(tf_utils::CreatePartitionedSession(graph, partition, {}, status) == nullptr);
+  CHECK(TF_GetCode(status) == TF_FAILED_PRECONDITION);
+
+  // TensorFlow reads the variable once per process, so the session still runs if it was read unset before.
+  SetEnvironmentVariable("TF_OVERRIDE_GLOBAL_THREADPOOL", "1");
+  SCOPE_EXIT{ SetEnvironmentVariable("TF_OVERRIDE_GLOBAL_THREADPOOL", nullptr); };
+  auto session = tf_utils::CreatePartitionedSession(graph, partition, tf_utils::SessionConfigBuilder().SetAllowSoftPlacement(true), status);
+  SCOPE_EXIT{ tf_utils::DeleteSession(session); };
+  REQUIRE(session != nullptr);
+
+  // Run callers live on an executor pinned to one CPU; the test thread keeps its CPU mask.
+  CHECK(tf_utils::CreatePinnedSessionExecutor({}, 1, 1, status) == nullptr);
+  const std::vector<std::int32_t> caller_cpus = {partition.tensorflow_cpus.front()};
+  auto executor = tf_utils::CreatePinnedSessionExecutor(caller_cpus, 0, 4, status);
+  SCOPE_EXIT{ tf_utils::DeleteSessionExecutor(executor); };
+  REQUIRE(executor != nullptr);
+  CHECK(executor->num_threads() == 1);
+#if defined(__linux__)
+  std::promise<int> worker_cpu;
+  REQUIRE(executor->TrySubmit([&worker_cpu] { worker_cpu.set_value(sched_getcpu()); }));
+  CHECK(worker_cpu.get_future().get() == caller_cpus.front());
+#endif
+
+  const std::vector<TF_Tensor*> input_tensors = {tf_utils::CreateTensor(TF_FLOAT, std::vector<std::int64_t>{1}, std::vector<float>{4.0f})};
+  SCOPE_EXIT{ tf_utils::DeleteTensors(input_tensors); };
+  auto pending = tf_utils::RunSessionAsync(executor, session, {TF_Output{input, 0}}, input_tensors, {TF_Output{output, 0}}, status);
+  REQUIRE(pending.valid());
+  auto result = pending.get();
+  SCOPE_EXIT{ tf_utils::DeleteTensors(result.output_tensors); };
+  REQUIRE(result.code == TF_OK);
+  CHECK(tf_utils::GetTensorData<float>(result.output_tensors[0]) == std::vector<float>{4.0f});
+}
+
+TEST_CASE("NumaSessionGroup routes runs to node sessions") {
+  auto status = TF_NewStatus();
+  SCOPE_EXIT{ TF_DeleteStatus(status); };
+
+  // Multi-node groups require per-session intra-op pools. The sessions below still run if TensorFlow already read
+  // the variable, which it only does once per process.
+  SetEnvironmentVariable("TF_OVERRIDE_GLOBAL_THREADPOOL", "1");
+  SCOPE_EXIT{ SetEnvironmentVariable("TF_OVERRIDE_GLOBAL_THREADPOOL", nullptr); };
+
+  CHECK(tf_utils::CreateNumaSessionGroup(nullptr, tf_utils::SessionConfigBuilder(), 0, 16, status) == nullptr);
+  CHECK(TF_GetCode(status) == TF_INVALID_ARGUMENT);
+
+  auto graph = TF_NewGraph();
+  SCOPE_EXIT{ TF_DeleteGraph(graph); };
+
+  auto input = AddPlaceholder(graph, "input", TF_FLOAT, status);
+  REQUIRE(TF_GetCode(status) == TF_OK);
+  auto scale = AddFloatConst(graph, "scale", 2.0f, status);
+  REQUIRE(TF_GetCode(status) == TF_OK);
+  auto output = AddMul(graph, "output", TF_Output{input, 0}, TF_Output{scale, 0}, status);
+  REQUIRE(TF_GetCode(status) == TF_OK);
+
+  auto group = tf_utils::CreateNumaSessionGroup(graph, tf_utils::SessionConfigBuilder().SetIntraOpParallelismThreads(1), 2, 16, status);
+  SCOPE_EXIT{ tf_utils::DeleteNumaSessionGroup(group); };
+  REQUIRE(group != nullptr);
+  REQUIRE(group->num_nodes() >= 1);
+
+  for (std::size_t node = 0; node < group->num_nodes(); ++node) {
+    CHECK(group->session(node) != nullptr);
+    CHECK(group->load(node) == 0);
+    CHECK(group->node_cpus(node).empty() == (group->node_id(node) < 0));
+
+    const std::vector<TF_Tensor*> input_tensors = {group->CreateTensor(node, TF_FLOAT, {2}, status)};
+    SCOPE_EXIT{ tf_utils::DeleteTensors(input_tensors); };
+    REQUIRE(input_tensors[0] != nullptr);
+    const float values[] = {1.0f, 3.0f};
+    std::memcpy(TF_TensorData(input_tensors[0]), values, sizeof(values));
+
+    std::vector<TF_Tensor*> output_tensors = {nullptr};
+    SCOPE_EXIT{ tf_utils::DeleteTensors(output_tensors); };
+    REQUIRE(group->Run(node, {TF_Output{input, 0}}, input_tensors, {TF_Output{output, 0}}, output_tensors, status) == TF_OK);
+    CHECK(tf_utils::GetTensorData<float>(output_tensors[0]) == std::vector<float>{2.0f, 6.0f});
+  }
+  CHECK(group->LeastLoadedNode() == 0);
+  CHECK(group->CreateTensor(0, TF_STRING, {1}, status) == nullptr);
+  CHECK(TF_GetCode(status) == TF_INVALID_ARGUMENT);
+  CHECK(group->CreateTensor(group->num_nodes(), TF_FLOAT, {1}) == nullptr);
+
+  std::vector<TF_Tensor*> output_tensors = {nullptr};
+  CHECK(group->Run(group->num_nodes(), {}, {}, {TF_Output{output, 0}}, output_tensors, status) == TF_INVALID_ARGUMENT);
+  CHECK(group->Run({}, {}, {TF_Output{output, 0}}, output_tensors, status) != TF_OK); // The placeholder is not fed.
+  CHECK(output_tensors[0] == nullptr);
+}
+
+TEST_CASE("HedgedRunner duplicates slow runs on a second pooled session") {
+  auto status = TF_NewStatus();
+  SCOPE_EXIT{ TF_DeleteStatus(status); };
+
+  auto graph = TF_NewGraph();
+  SCOPE_EXIT{ TF_DeleteGraph(graph); };
+
+  auto input = AddPlaceholder(graph, "input", TF_FLOAT, status);
+  REQUIRE(TF_GetCode(status) == TF_OK);
+  auto scale = AddFloatConst(graph, "scale", 2.0f, status);
+  REQUIRE(TF_GetCode(status) == TF_OK);
+  auto output = AddMul(graph, "output", TF_Output{input, 0}, TF_Output{scale, 0}, status);
+  REQUIRE(TF_GetCode(status) == TF_OK);
+
+  auto pool = tf_utils::CreateSessionPool(graph, 2, nullptr, status);
+  SCOPE_EXIT{ tf_utils::DeleteSessionPool(pool); };
+  REQUIRE(pool != nullptr);
+  // Deleted before the pool, so runs that lost a race have returned their sessions.
+  auto executor = tf_utils::CreateSessionExecutor(2, 16, status);
+  SCOPE_EXIT{ tf_utils::DeleteSessionExecutor(executor); };
+  REQUIRE(executor != nullptr);
+
+  // Run owns its inputs, so every run gets new ones.
+  const auto make_inputs = [] {
+    return std::vector<TF_Tensor*>{tf_utils::CreateTensor(TF_FLOAT, std::vector<std::int64_t>{2}, std::vector<float>{1.0f, 3.0f})};
+  };
+
+  tf_utils::HedgedRunner::Options options;
+  options.percentile = 50.0;
+  options.window = 4;
+  options.min_samples = 4;
+  tf_utils::HedgedRunner warmup(pool, executor, {TF_Output{input, 0}}, {TF_Output{output, 0}}, options);
+  std::vector<TF_Tensor*> no_outputs;
+  CHECK(warmup.Run({}, no_outputs, status) == TF_INVALID_ARGUMENT);
+  auto rejected_inputs = make_inputs();
+  rejected_inputs.push_back(nullptr);
+  CHECK(warmup.Run(std::move(rejected_inputs), no_outputs, status) == TF_INVALID_ARGUMENT);
+  CHECK(rejected_inputs.empty());
+  for (int i = 0; i < 4; ++i) {
+    CHECK(warmup.hedge_delay() == std::chrono::nanoseconds::max());
+    std::vector<TF_Tensor*> output_tensors;
+    SCOPE_EXIT{ tf_utils::DeleteTensors(output_tensors); };
+    REQUIRE(warmup.Run(make_inputs(), output_tensors, status) == TF_OK);
+    CHECK(tf_utils::GetTensorData<float>(output_tensors[0]) == std::vector<float>{2.0f, 6.0f});
+  }
+  CHECK(warmup.hedge_delay() < std::chrono::nanoseconds::max());
+  CHECK(warmup.counters().runs == 4);
+  CHECK(warmup.counters().hedges == 0);
+
+  // A zero delay hedges every run that has not finished when Run starts waiting; which run wins is up to the scheduler.
+  options.initial_delay = std::chrono::nanoseconds{0};
+  options.min_samples = 1000;
+  tf_utils::HedgedRunner hedged(pool, executor, {TF_Output{input, 0}}, {TF_Output{output, 0}}, options);
+  for (int i = 0; i < 20; ++i) {
+    std::vector<TF_Tensor*> output_tensors;
+    SCOPE_EXIT{ tf_utils::DeleteTensors(output_tensors); };
+    REQUIRE(hedged.Run(make_inputs(), output_tensors, status) == TF_OK);
+    CHECK(tf_utils::GetTensorData<float>(output_tensors[0]) == std::vector<float>{2.0f, 6.0f});
+  }
+  auto counters = hedged.counters();
+  CHECK(counters.runs == 20);
+  CHECK(counters.hedges + counters.hedges_skipped <= counters.runs);
+  CHECK(counters.hedge_wins <= counters.hedges);
+
+  // With both workers busy the primary run is still queued after the delay, so the run is always hedged.
+  std::promise<void> release_workers;
+  auto workers_released = release_workers.get_future().share();
+  std::atomic<int> busy_workers{0};
+  for (int i = 0; i < 2; ++i) {
+    REQUIRE(executor->TrySubmit([&busy_workers, workers_released] {
+      ++busy_workers;
+      workers_released.wait();
+    }));
+  }
+  while (busy_workers < 2) {
+    std::this_thread::yield();
+  }
+  auto blocked_run = std::async(std::launch::async, [&] {
+    auto run_status = TF_NewStatus();
+    SCOPE_EXIT{ TF_DeleteStatus(run_status); };
+    std::vector<TF_Tensor*> output_tensors;
+    SCOPE_EXIT{ tf_utils::DeleteTensors(output_tensors); };
+    return hedged.Run(make_inputs(), output_tensors, run_status);
+  });
+  while (executor->queue_depth() < 2) {
+    std::this_thread::yield();
+  }
+  release_workers.set_value();
+  CHECK(blocked_run.get() == TF_OK);
+  counters = hedged.counters();
+  CHECK(counters.runs == 21);
+  CHECK(counters.hedges >= 1);
+
+  options.max_concurrent_hedges = 0;
+  tf_utils::HedgedRunner capped(pool, executor, {TF_Output{input, 0}}, {TF_Output{output, 0}}, options);
+  for (int i = 0; i < 4; ++i) {
+    std::vector<TF_Tensor*> output_tensors;
+    SCOPE_EXIT{ tf_utils::DeleteTensors(output_tensors); };
+    REQUIRE(capped.Run(make_inputs(), output_tensors, status) == TF_OK);
+  }
+  CHECK(capped.counters().hedges == 0);
+
+  tf_utils::HedgedRunner::Counters totals;
+  totals.runs = 4;
+  totals.hedges = 2;
+  totals.hedge_wins = 1;
+  CHECK(totals.hedge_rate() == doctest::Approx(0.5));
+  CHECK(totals.win_rate() == doctest::Approx(0.5));
+  CHECK(tf_utils::HedgedRunner::Counters{}.hedge_rate() == 0.0);
+}
+
 TEST_CASE("CreateStringTensor validates shape and round-trips embedded nulls") {
   const std::vector<std::int64_t> dims = {2};
   const std::vector<std::string> strings = {"owned string", std::string("a\0b", 3)};
@@ -608,6 +1608,204 @@ TEST_CASE("CreateStringTensor supports scalar and empty strings") {
   CHECK(tf_utils::GetStringTensorData(tensor) == strings);
 }
 
+TEST_CASE("CreateStringTensorFromFiles maps large files and copies small files") {
+  const auto directory = std::filesystem::temp_directory_path();
+  const auto small_path = (directory / "hello_tf_small_string_file.bin").string();
+  const auto large_path = (directory / "hello_tf_large_string_file.bin").string();
+  const auto empty_path = (directory / "hello_tf_empty_string_file.bin").string();
+  SCOPE_EXIT{
+    std::error_code error;
+    std::filesystem::remove(small_path, error);
+    std::filesystem::remove(large_path, error);
+    std::filesystem::remove(empty_path, error);
+  };
+
+  const std::string small_contents("small\0file", 10);
+  std::string large_contents(256 * 1024, '\0');
+  for (std::size_t i = 0; i < large_contents.size(); ++i) {
+    large_contents[i] = static_cast<char>(i % 251);
+  }
+
+  std::ofstream(small_path, std::ios::binary) << small_contents;
+  std::ofstream(large_path, std::ios::binary) << large_contents;
+  std::ofstream(empty_path, std::ios::binary).flush();
+
+  const std::vector<std::string> paths = {small_path, large_path, empty_path};
+  const std::vector<std::string> contents = {small_contents, large_contents, ""};
+
+  auto tensor = tf_utils::CreateStringTensorFromFiles(paths);
+  SCOPE_EXIT{ tf_utils::DeleteTensor(tensor); };
+
+  REQUIRE(tensor != nullptr);
+  CHECK(TF_TensorType(tensor) == TF_STRING);
+  REQUIRE(TF_NumDims(tensor) == 1);
+  CHECK(TF_Dim(tensor, 0) == static_cast<std::int64_t>(paths.size()));
+  CHECK(tf_utils::GetStringTensorData(tensor) == contents);
+
+  const auto strings = static_cast<const TF_TString*>(TF_TensorData(tensor));
+  CHECK(TF_StringGetType(&strings[1]) == TF_TSTR_VIEW);
+
+  CHECK(tf_utils::CreateStringTensorFromFiles({2}, paths) == nullptr);
+  CHECK(tf_utils::CreateStringTensorFromFiles(std::vector<std::string>{"missing_string_file.bin"}) == nullptr);
+  CHECK(tf_utils::CreateStringTensorFromFiles(nullptr, 0, nullptr, 1) == nullptr);
+}
+
+TEST_CASE("CreateBucketedStringTensors groups sequences by length and keeps request order") {
+  const std::vector<std::vector<std::string>> sequences = {
+    {"a", "b", "c", "d", "e"},
+    {"x"},
+    {},
+    {"p", "q", "r"},
+    {"long", "er", "one", "!", "?", "."},
+  };
+
+  std::vector<tf_utils::StringBucketBatch> batches;
+  SCOPE_EXIT{ tf_utils::DeleteStringBucketBatches(batches); };
+  REQUIRE(tf_utils::CreateBucketedStringTensors(sequences, {2, 4, 8}, batches, 0, "<pad>"));
+  REQUIRE(batches.size() == 3);
+
+  CHECK(batches[0].request_indices == std::vector<std::size_t>{1, 2});
+  CHECK(batches[1].request_indices == std::vector<std::size_t>{3});
+  CHECK(batches[2].request_indices == std::vector<std::size_t>{0, 4});
+
+  const auto& batch = batches[2];
+  REQUIRE(TF_NumDims(batch.tokens) == 2);
+  CHECK(TF_Dim(batch.tokens, 0) == 2);
+  CHECK(TF_Dim(batch.tokens, 1) == 6);
+  CHECK(tf_utils::GetStringTensorData(batch.tokens) == std::vector<std::string>{
+    "a", "b", "c", "d", "e", "<pad>",
+    "long", "er", "one", "!", "?", ".",
+  });
+  CHECK(tf_utils::GetTensorData<std::int32_t>(batch.lengths) == std::vector<std::int32_t>{5, 6});
+  CHECK(tf_utils::GetTensorData<std::int32_t>(batch.mask) == std::vector<std::int32_t>{1, 1, 1, 1, 1, 0, 1, 1, 1, 1, 1, 1});
+
+  CHECK(tf_utils::GetStringTensorData(batches[0].tokens) == std::vector<std::string>{"x", "<pad>"});
+  CHECK(tf_utils::GetTensorData<std::int32_t>(batches[0].mask) == std::vector<std::int32_t>{1, 0});
+
+  REQUIRE(tf_utils::CreateBucketedStringTensors(sequences, {8}, batches, 2));
+  REQUIRE(batches.size() == 3);
+  CHECK(batches[0].request_indices == std::vector<std::size_t>{0, 1});
+  CHECK(batches[2].request_indices == std::vector<std::size_t>{4});
+
+  CHECK_FALSE(tf_utils::CreateBucketedStringTensors(sequences, {2, 4}, batches));
+  CHECK(batches.empty());
+  CHECK_FALSE(tf_utils::CreateBucketedStringTensors(sequences, {8, 8}, batches));
+  CHECK_FALSE(tf_utils::CreateBucketedStringTensors(sequences, {}, batches));
+}
+
+TEST_CASE("CreateFixedWidthStringTensors pads short strings and round-trips") {
+  const std::vector<std::string> strings = {"token", "", std::string("a\0b", 3), "sixteen-bytes-ok"};
+
+  for (const std::size_t width : {std::size_t{16}, std::size_t{20}}) {
+    TF_Tensor* bytes = nullptr;
+    TF_Tensor* lengths = nullptr;
+    REQUIRE(tf_utils::CreateFixedWidthStringTensors(strings, width, &bytes, &lengths));
+    SCOPE_EXIT{ tf_utils::DeleteTensor(bytes); };
+    SCOPE_EXIT{ tf_utils::DeleteTensor(lengths); };
+
+    CHECK(TF_TensorType(bytes) == TF_UINT8);
+    REQUIRE(TF_NumDims(bytes) == 2);
+    CHECK(TF_Dim(bytes, 0) == static_cast<std::int64_t>(strings.size()));
+    CHECK(TF_Dim(bytes, 1) == static_cast<std::int64_t>(width));
+    CHECK(tf_utils::GetTensorData<std::int32_t>(lengths) == std::vector<std::int32_t>{5, 0, 3, 16});
+
+    const auto packed = tf_utils::GetTensorData<std::uint8_t>(bytes);
+    CHECK(packed[5] == 0);
+    CHECK(packed[width] == 0);
+    CHECK(tf_utils::GetFixedWidthStringTensorData(bytes, lengths) == strings);
+  }
+
+  TF_Tensor* bytes = nullptr;
+  TF_Tensor* lengths = nullptr;
+  CHECK_FALSE(tf_utils::CreateFixedWidthStringTensors(strings, 8, &bytes, &lengths));
+  CHECK(bytes == nullptr);
+  CHECK(lengths == nullptr);
+  CHECK_FALSE(tf_utils::CreateFixedWidthStringTensors(nullptr, 1, 8, &bytes, &lengths));
+}
+
+TEST_CASE("ExportTensorToArrow shares numeric tensor data") {
+  const std::vector<std::int64_t> dims = {2, 2};
+  const std::vector<std::int32_t> values = {1, -2, 3, -4};
+
+  auto tensor = tf_utils::CreateTensor(TF_INT32, dims, values);
+  REQUIRE(tensor != nullptr);
+  const auto tensor_data = TF_TensorData(tensor);
+
+  ArrowArray array;
+  ArrowSchema schema;
+  REQUIRE(tf_utils::ExportTensorToArrow(tensor, &array, &schema));
+  SCOPE_EXIT{ array.release(&array); };
+  SCOPE_EXIT{ schema.release(&schema); };
+
+  // The [2, 2] shape is kept as a fixed_size_list of two-element lists over the flat values.
+  CHECK(std::string(schema.format) == "+w:2");
+  REQUIRE(schema.n_children == 1);
+  CHECK(std::string(schema.children[0]->format) == "i");
+  CHECK(array.length == 2);
+  CHECK(array.null_count == 0);
+  REQUIRE(array.n_buffers == 1);
+  CHECK(array.buffers[0] == nullptr);
+  REQUIRE(array.n_children == 1);
+
+  // A consumer may move the values out and release them separately.
+  auto values_array = *array.children[0];
+  array.children[0]->release = nullptr;
+  SCOPE_EXIT{ values_array.release(&values_array); };
+  CHECK(values_array.length == 4);
+  REQUIRE(values_array.n_buffers == 2);
+  CHECK(values_array.buffers[0] == nullptr);
+  REQUIRE(values_array.buffers[1] == tensor_data);
+  CHECK(std::memcmp(values_array.buffers[1], values.data(), values.size() * sizeof(std::int32_t)) == 0);
+}
+
+TEST_CASE("ExportTensorToArrow packs string and bool tensors") {
+  const std::vector<std::string> strings = {"arrow", "", std::string("a\0b", 3)};
+  auto string_tensor = tf_utils::CreateStringTensor({3}, strings);
+  REQUIRE(string_tensor != nullptr);
+
+  ArrowArray string_array;
+  ArrowSchema string_schema;
+  REQUIRE(tf_utils::ExportTensorToArrow(string_tensor, &string_array, &string_schema));
+  SCOPE_EXIT{ string_schema.release(&string_schema); };
+
+  CHECK(std::string(string_schema.format) == "z");
+  CHECK(string_array.length == 3);
+  REQUIRE(string_array.n_buffers == 3);
+  CHECK(string_array.buffers[0] == nullptr);
+  const auto offsets = static_cast<const std::int32_t*>(string_array.buffers[1]);
+  const auto bytes = static_cast<const char*>(string_array.buffers[2]);
+  CHECK(std::vector<std::int32_t>(offsets, offsets + 4) == std::vector<std::int32_t>{0, 5, 5, 8});
+  CHECK(std::string(bytes, 8) == strings[0] + strings[2]);
+
+  string_array.release(&string_array);
+  CHECK(string_array.release == nullptr);
+
+  const std::vector<std::uint8_t> flags = {1, 0, 1, 1, 0, 0, 0, 0, 1};
+  auto bool_tensor = tf_utils::CreateTensor(TF_BOOL, std::vector<std::int64_t>{9}.data(), 1, flags.data(), flags.size());
+  REQUIRE(bool_tensor != nullptr);
+
+  ArrowArray bool_array;
+  REQUIRE(tf_utils::ExportTensorToArrow(bool_tensor, &bool_array));
+  SCOPE_EXIT{ bool_array.release(&bool_array); };
+
+  CHECK(bool_array.length == 9);
+  const auto bitmap = static_cast<const std::uint8_t*>(bool_array.buffers[1]);
+  CHECK(bitmap[0] == 0x0d);
+  CHECK(bitmap[1] == 0x01);
+}
+
+TEST_CASE("ExportTensorToArrow leaves unsupported tensors with the caller") {
+  auto tensor = tf_utils::CreateEmptyTensor(TF_BFLOAT16, std::vector<std::int64_t>{2});
+  SCOPE_EXIT{ tf_utils::DeleteTensor(tensor); };
+  REQUIRE(tensor != nullptr);
+
+  ArrowArray array;
+  CHECK_FALSE(tf_utils::ExportTensorToArrow(tensor, &array));
+  CHECK_FALSE(tf_utils::ExportTensorToArrow(nullptr, &array));
+  CHECK_FALSE(tf_utils::ExportTensorToArrow(tensor, nullptr));
+  CHECK(TF_TensorType(tensor) == TF_BFLOAT16);
+}
+
 TEST_CASE("TF_STRING tensor round-trips through TensorFlow SessionRun") {
   auto status = TF_NewStatus();
   SCOPE_EXIT{ TF_DeleteStatus(status); };